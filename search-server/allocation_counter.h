@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Счётчики выделений памяти через глобальный operator new. Замена
+ * operator new находится в allocation_counter.cpp и действует на всю
+ * программу, в которую этот файл скомпонован.
+ */
+
+// Число вызовов operator new с начала работы программы
+size_t GetAllocationCount();
+
+// Суммарный размер запрошенной памяти в байтах
+size_t GetAllocatedBytes();
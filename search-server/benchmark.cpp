@@ -0,0 +1,365 @@
+#include "benchmark.h"
+
+#include "allocation_counter.h"
+#include "corpus_generator.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <execution>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Не даёт компилятору выбросить вычисления, результат которых не нужен
+volatile double result_sink = 0.0;
+
+const int MAX_WORD_LENGTH = 10;
+const int MATCHED_DOCUMENTS_PER_QUERY = 10;
+const int DUPLICATE_RATIO = 10;
+
+void Consume(const std::vector<Document> &documents) {
+  for (const Document &document : documents) {
+    result_sink = result_sink + document.relevance;
+  }
+}
+
+// Если задан cached_server, выводится доля попаданий в его кеш результатов
+template <typename Function>
+void Measure(std::ostream &out, std::string_view name,
+  const BenchmarkConfig &config, size_t operation_count, Function func,
+  const SearchServer *cached_server = nullptr) {
+  using Clock = std::chrono::steady_clock;
+
+  const QueryCache::Stats cache_before = cached_server != nullptr
+    ? cached_server->GetQueryCacheStats() : QueryCache::Stats();
+  const size_t allocations_before = GetAllocationCount();
+  const size_t bytes_before = GetAllocatedBytes();
+  const auto start_time = Clock::now();
+
+  func();
+
+  const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - start_time).count();
+  const double operations = static_cast<double>(
+    std::max<size_t>(operation_count, 1));
+
+  out << name << ','
+    << config.document_count << ','
+    << config.vocabulary_size << ','
+    << config.query_word_count << ','
+    << operation_count << ','
+    << duration / operations << ','
+    << (duration > 0 ? operations * 1e9 / duration : 0.0) << ','
+    << (GetAllocationCount() - allocations_before) / operations << ','
+    << (GetAllocatedBytes() - bytes_before) / operations << ',';
+  if (cached_server != nullptr) {
+    const QueryCache::Stats cache_after = cached_server->GetQueryCacheStats();
+    const auto hits = cache_after.hits - cache_before.hits;
+    const auto lookups = hits + cache_after.misses - cache_before.misses;
+    out << (lookups > 0 ? static_cast<double>(hits) / lookups : 0.0);
+  }
+  out << std::endl;
+}
+
+template <typename FindFunction>
+void MeasureFindTopDocuments(std::ostream &out, std::string_view name,
+  const BenchmarkConfig &config, const std::vector<std::string> &queries,
+  FindFunction find, const SearchServer *cached_server = nullptr) {
+  Measure(out, name, config, queries.size(), [&queries, &find] {
+    for (const std::string &query : queries) {
+      Consume(find(query));
+    }
+  }, cached_server);
+}
+
+template <typename MatchFunction>
+void MeasureMatchDocument(std::ostream &out, std::string_view name,
+  const BenchmarkConfig &config, const std::vector<std::string> &queries,
+  MatchFunction match) {
+  Measure(out, name, config, queries.size() * MATCHED_DOCUMENTS_PER_QUERY,
+    [&config, &queries, &match] {
+      for (size_t i = 0; i < queries.size(); ++i) {
+        for (int j = 0; j < MATCHED_DOCUMENTS_PER_QUERY; ++j) {
+          const int document_id = static_cast<int>(
+            (i * MATCHED_DOCUMENTS_PER_QUERY + j) % config.document_count);
+          const auto [words, status] = match(queries[i], document_id);
+          result_sink = result_sink + words.size();
+        }
+      }
+    });
+}
+
+template <typename RemoveFunction>
+void MeasureRemoveDocument(std::ostream &out, std::string_view name,
+  const BenchmarkConfig &config, const SearchServer &search_server,
+  RemoveFunction remove) {
+  SearchServer copy = search_server;
+  Measure(out, name, config, config.document_count, [&config, &copy, &remove] {
+    for (int document_id = 0; document_id < config.document_count;
+      ++document_id) {
+      remove(copy, document_id);
+    }
+  });
+}
+
+void RunBenchmark(std::ostream &out, const BenchmarkConfig &config) {
+  std::mt19937 generator;
+
+  const auto dictionary = GenerateDictionary(generator,
+    config.vocabulary_size, MAX_WORD_LENGTH);
+  const auto documents = GenerateQueries(generator, dictionary,
+    config.document_count, config.document_word_count);
+  const auto queries = GenerateQueries(generator, dictionary,
+    config.query_count, config.query_word_count, config.minus_prob);
+
+  SearchServer search_server(dictionary[0]);
+  Measure(out, "AddDocument", config, documents.size(),
+    [&search_server, &documents] {
+      for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i), documents[i],
+          static_cast<DocumentStatus>(i % 4), {1, 2, 3});
+      }
+    });
+
+  const auto predicate = [](int document_id, DocumentStatus, int) {
+    return document_id % 2 == 0;
+  };
+
+  MeasureFindTopDocuments(out, "FindTopDocuments", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(query);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/status", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(query, DocumentStatus::BANNED);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/predicate", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(query, predicate);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/seq", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::seq, query);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/seq/status", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::seq, query,
+        DocumentStatus::BANNED);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/seq/predicate", config,
+    queries, [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::seq, query,
+        predicate);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/par", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::par, query);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/par/status", config, queries,
+    [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::par, query,
+        DocumentStatus::BANNED);
+    });
+  MeasureFindTopDocuments(out, "FindTopDocuments/par/predicate", config,
+    queries, [&](std::string_view query) {
+      return search_server.FindTopDocuments(std::execution::par, query,
+        predicate);
+    });
+
+  // Те же параллельные вызовы на пуле потоков сервера
+  {
+    SearchServer pooled = search_server;
+    pooled.SetThreadPool(std::make_shared<ThreadPool>());
+    MeasureFindTopDocuments(out, "FindTopDocuments/pool", config, queries,
+      [&](std::string_view query) {
+        return pooled.FindTopDocuments(std::execution::par, query);
+      });
+    Measure(out, "ProcessQueries/pool", config, queries.size(),
+      [&pooled, &queries] {
+        for (const auto &documents : ProcessQueries(pooled, queries)) {
+          Consume(documents);
+        }
+      });
+  }
+
+  // Оценка по квантованным частотам
+  for (const auto &[name, quantization] : {
+    std::pair{"FindTopDocuments/par/impact16", ImpactQuantization::BITS_16},
+    std::pair{"FindTopDocuments/par/impact8", ImpactQuantization::BITS_8}}) {
+    SearchServer quantized = search_server;
+    quantized.SetImpactQuantization(quantization);
+    MeasureFindTopDocuments(out, name, config, queries,
+      [&](std::string_view query) {
+        return quantized.FindTopDocuments(std::execution::par, query);
+      });
+  }
+
+  // Частоты, вычисляемые по 16-битным числам вхождений
+  {
+    SearchServer counted = search_server;
+    counted.SetTermFreqStorage(TermFreqStorage::COUNTS);
+    MeasureFindTopDocuments(out, "FindTopDocuments/counts", config, queries,
+      [&](std::string_view query) {
+        return counted.FindTopDocuments(query);
+      });
+  }
+
+  // Повторные запросы к кешу результатов размером с набор запросов; первый
+  // проход заполняет кеш, поэтому замеряются только попадания
+  {
+    SearchServer cached = search_server;
+    cached.SetQueryCacheCapacity(queries.size());
+    for (const std::string &query : queries) {
+      Consume(cached.FindTopDocuments(query));
+    }
+    MeasureFindTopDocuments(out, "FindTopDocuments/cached", config, queries,
+      [&](std::string_view query) {
+        return cached.FindTopDocuments(query);
+      }, &cached);
+  }
+
+  MeasureMatchDocument(out, "MatchDocument", config, queries,
+    [&](std::string_view query, int document_id) {
+      return search_server.MatchDocument(query, document_id);
+    });
+  MeasureMatchDocument(out, "MatchDocument/seq", config, queries,
+    [&](std::string_view query, int document_id) {
+      return search_server.MatchDocument(std::execution::seq, query,
+        document_id);
+    });
+  MeasureMatchDocument(out, "MatchDocument/par", config, queries,
+    [&](std::string_view query, int document_id) {
+      return search_server.MatchDocument(std::execution::par, query,
+        document_id);
+    });
+
+  // Те же пары запрос-документ, сопоставленные одним вызовом на запрос
+  for (const bool is_parallel : {false, true}) {
+    Measure(out, is_parallel ? "MatchDocuments/par" : "MatchDocuments/seq",
+      config, queries.size() * MATCHED_DOCUMENTS_PER_QUERY,
+      [&config, &queries, &search_server, is_parallel] {
+        std::vector<int> document_ids(MATCHED_DOCUMENTS_PER_QUERY);
+        std::vector<SearchServer::MatchResult> results;
+        for (size_t i = 0; i < queries.size(); ++i) {
+          for (int j = 0; j < MATCHED_DOCUMENTS_PER_QUERY; ++j) {
+            document_ids[j] = static_cast<int>(
+              (i * MATCHED_DOCUMENTS_PER_QUERY + j) % config.document_count);
+          }
+          if (is_parallel) {
+            search_server.MatchDocuments(std::execution::par, queries[i],
+              document_ids, results);
+          } else {
+            search_server.MatchDocuments(std::execution::seq, queries[i],
+              document_ids, results);
+          }
+          for (const auto &[words, status] : results) {
+            result_sink = result_sink + words.size();
+          }
+        }
+      });
+  }
+
+  Measure(out, "GetWordFrequencies", config, config.document_count,
+    [&search_server] {
+      for (const int document_id : search_server) {
+        for (const auto &[word, term_freq] :
+          search_server.GetWordFrequencies(document_id)) {
+          result_sink = result_sink + term_freq;
+        }
+      }
+    });
+
+  Measure(out, "ProcessQueries", config, queries.size(),
+    [&search_server, &queries] {
+      for (const auto &documents : ProcessQueries(search_server, queries)) {
+        Consume(documents);
+      }
+    });
+  Measure(out, "ProcessQueriesJoined", config, queries.size(),
+    [&search_server, &queries] {
+      Consume(ProcessQueriesJoined(search_server, queries));
+    });
+  Measure(out, "ProcessQueriesJoined/sink", config, queries.size(),
+    [&search_server, &queries] {
+      ProcessQueriesJoined(search_server, queries,
+        [](const Document &document) {
+          result_sink = result_sink + document.relevance;
+        });
+    });
+
+  // Каждый DUPLICATE_RATIO-й документ повторяется под новым идентификатором.
+  // RemoveDuplicates сообщает о каждом дубликате в std::cout, на время
+  // замера вывод отключается
+  {
+    SearchServer copy = search_server;
+    for (int i = 0; i < config.document_count; i += DUPLICATE_RATIO) {
+      copy.AddDocument(config.document_count + i, documents[i],
+        DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    SearchServer near_copy = copy;
+
+    Measure(out, "RemoveDuplicates/near", config,
+      near_copy.GetDocumentCount(), [&near_copy] {
+        RemoveDuplicates(std::execution::par, near_copy, 0.8);
+      });
+
+    std::ostringstream report;
+    std::streambuf *const cout_buffer = std::cout.rdbuf(nullptr);
+    Measure(report, "RemoveDuplicates", config, copy.GetDocumentCount(),
+      [&copy] {
+        RemoveDuplicates(copy);
+      });
+    std::cout.rdbuf(cout_buffer);
+    std::cout.clear();
+    out << report.str();
+  }
+
+  MeasureRemoveDocument(out, "RemoveDocument", config, search_server,
+    [](SearchServer &server, int document_id) {
+      server.RemoveDocument(document_id);
+    });
+  MeasureRemoveDocument(out, "RemoveDocument/seq", config, search_server,
+    [](SearchServer &server, int document_id) {
+      server.RemoveDocument(std::execution::seq, document_id);
+    });
+  MeasureRemoveDocument(out, "RemoveDocument/par", config, search_server,
+    [](SearchServer &server, int document_id) {
+      server.RemoveDocument(std::execution::par, document_id);
+    });
+}
+
+}  // namespace
+
+std::vector<BenchmarkConfig> GetDefaultBenchmarkConfigs() {
+  std::vector<BenchmarkConfig> configs;
+  for (const int document_count : {1'000, 10'000}) {
+    for (const int vocabulary_size : {1'000, 10'000}) {
+      for (const int query_word_count : {3, 10, 70}) {
+        BenchmarkConfig config;
+        config.document_count = document_count;
+        config.vocabulary_size = vocabulary_size;
+        config.query_word_count = query_word_count;
+        configs.push_back(config);
+      }
+    }
+  }
+  return configs;
+}
+
+void RunBenchmarks(std::ostream &out,
+  const std::vector<BenchmarkConfig> &configs) {
+  out << "name,documents,vocabulary,query_words,operations,ns_per_op,"
+    "ops_per_sec,allocs_per_op,bytes_per_op,cache_hit_rate" << std::endl;
+  for (const BenchmarkConfig &config : configs) {
+    RunBenchmark(out, config);
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+// Параметры синтетического корпуса и запросов одного прогона
+struct BenchmarkConfig {
+  int document_count = 10'000;
+  int vocabulary_size = 1'000;
+  int document_word_count = 70;
+  int query_count = 100;
+  int query_word_count = 10;
+  double minus_prob = 0.1;
+};
+
+// Сетка по размеру корпуса, размеру словаря и длине запросов
+std::vector<BenchmarkConfig> GetDefaultBenchmarkConfigs();
+
+/**
+ * Замеряет AddDocument, все перегрузки FindTopDocuments с каждой политикой,
+ * MatchDocument, ProcessQueries, RemoveDuplicates и RemoveDocument.
+ * Корпус и запросы строятся генератором с фиксированным seed, поэтому
+ * прогоны воспроизводимы.
+ *
+ * Результат выводится в формате CSV, одна строка на операцию и конфигурацию:
+ * время на операцию (нс), операций в секунду, выделений памяти и байт на
+ * операцию, для замеров кеша результатов - доля попаданий. Выделения
+ * считаются заменённым глобальным operator new.
+ */
+void RunBenchmarks(std::ostream &out,
+  const std::vector<BenchmarkConfig> &configs = GetDefaultBenchmarkConfigs());
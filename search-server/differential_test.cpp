@@ -0,0 +1,334 @@
+#include "differential_test.h"
+
+#include "corpus_generator.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+
+#include <cmath>
+#include <cstdio>
+#include <execution>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+const int VOCABULARY_SIZE = 300;
+const int MAX_WORD_LENGTH = 8;
+const int STOP_WORD_COUNT = 3;
+const int DOCUMENT_WORD_COUNT = 30;
+const int ROUND_COUNT = 8;
+const int ROUND_DOCUMENT_COUNT = 300;
+const int QUERY_COUNT = 40;
+const int QUERY_WORD_COUNT = 6;
+// Длинные запросы оцениваются без отсечения
+const int LONG_QUERY_COUNT = 5;
+const int LONG_QUERY_WORD_COUNT = MAX_PRUNED_QUERY_WORD_COUNT + 4;
+const double MINUS_PROB = 0.2;
+// Доля живых документов, удаляемых за раунд, в процентах
+const int REMOVED_PERCENT = 10;
+const size_t QUERY_CACHE_CAPACITY = 64;
+const size_t SHARD_COUNT = 3;
+// Шарды и квантованные частоты складывают вклады в другом порядке
+const double RELEVANCE_TOLERANCE = 1e-9;
+
+const DocumentStatus CHECKED_STATUSES[] = {
+  DocumentStatus::ACTUAL,
+  DocumentStatus::BANNED,
+};
+
+// Живой документ модели корпуса
+struct StoredDocument {
+  std::string text;
+  DocumentStatus status = DocumentStatus::ACTUAL;
+  std::vector<int> ratings;
+};
+
+using Corpus = std::map<int, StoredDocument>;
+
+// Считает расхождения и выводит каждое
+class Checker {
+public:
+  explicit Checker(std::ostream &out)
+    : out_(out) {
+  }
+
+  void Compare(std::string_view mode, std::string_view query,
+    DocumentStatus status, const std::vector<Document> &expected,
+    const std::vector<Document> &actual) {
+    if (IsSame(expected, actual)) {
+      return;
+    }
+    out_ << mode << ": query \"" << query << "\", status "
+      << static_cast<int>(status) << std::endl;
+    Print("  expected", expected);
+    Print("  actual", actual);
+    ++failure_count_;
+  }
+
+  void Expect(bool condition, std::string_view mode, std::string_view what) {
+    if (!condition) {
+      out_ << mode << ": " << what << std::endl;
+      ++failure_count_;
+    }
+  }
+
+  [[nodiscard]] int GetFailureCount() const {
+    return failure_count_;
+  }
+
+private:
+  std::ostream &out_;
+  int failure_count_ = 0;
+
+  static bool IsSame(const std::vector<Document> &lhs,
+    const std::vector<Document> &rhs) {
+    if (lhs.size() != rhs.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      if (lhs[i].id != rhs[i].id || lhs[i].rating != rhs[i].rating
+        || std::abs(lhs[i].relevance - rhs[i].relevance)
+          > RELEVANCE_TOLERANCE) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Print(std::string_view label, const std::vector<Document> &documents) {
+    out_ << label << ':';
+    for (const Document &document : documents) {
+      out_ << ' ' << document;
+    }
+    out_ << std::endl;
+  }
+};
+
+// Сервер, заново построенный из живых документов, с полным перебором
+SearchServer BuildReference(const std::vector<std::string> &stop_words,
+  const Corpus &corpus) {
+  SearchServer reference(stop_words);
+  reference.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+  for (const auto &[document_id, document] : corpus) {
+    reference.AddDocument(document_id, document.text, document.status,
+      document.ratings);
+  }
+  return reference;
+}
+
+// Сверяет find(query, status) с эталоном на всех запросах и статусах
+template <typename FindFunction>
+void CompareWithReference(Checker &checker, std::string_view mode,
+  const SearchServer &reference, const std::vector<std::string> &queries,
+  FindFunction find) {
+  for (const DocumentStatus status : CHECKED_STATUSES) {
+    for (const std::string &query : queries) {
+      checker.Compare(mode, query, status,
+        reference.FindTopDocuments(std::execution::seq, query, status),
+        find(query, status));
+    }
+  }
+}
+
+// Пакеты с существующим идентификатором и со спецсимволом отклоняются
+// целиком, до изменения индекса
+void CheckRejectedBatches(Checker &checker, std::mt19937 &generator,
+  const std::vector<std::string> &dictionary, SearchServer &search_server,
+  const Corpus &corpus, int next_document_id) {
+  const std::string text = GenerateQuery(generator, dictionary,
+    DOCUMENT_WORD_COUNT);
+  const std::string invalid_text = text + " bad\x01word";
+
+  const std::vector<std::vector<DocumentInput>> batches = {
+    {{next_document_id, text, DocumentStatus::ACTUAL, {1}},
+      {corpus.begin()->first, text, DocumentStatus::ACTUAL, {1}}},
+    {{next_document_id, text, DocumentStatus::ACTUAL, {1}},
+      {next_document_id + 1, invalid_text, DocumentStatus::ACTUAL, {1}}},
+  };
+
+  for (const auto &batch : batches) {
+    bool is_rejected = false;
+    try {
+      search_server.AddDocuments(std::execution::par, batch);
+    } catch (const std::invalid_argument &) {
+      is_rejected = true;
+    }
+    checker.Expect(is_rejected, "AddDocuments rollback",
+      "invalid batch was accepted");
+  }
+  checker.Expect(
+    search_server.GetDocumentCount() == static_cast<int>(corpus.size()),
+    "AddDocuments rollback", "document count changed");
+}
+
+// Проверки индекса после очередного раунда изменений
+void CheckRound(Checker &checker, const std::vector<std::string> &stop_words,
+  const Corpus &corpus, const SearchServer &search_server,
+  const ShardedSearchServer &sharded_server,
+  const std::vector<std::string> &queries, const std::string &snapshot_path) {
+  const SearchServer reference = BuildReference(stop_words, corpus);
+
+  checker.Expect(
+    search_server.GetDocumentCount() == static_cast<int>(corpus.size()),
+    "document count", "differs from the model");
+  checker.Expect(
+    sharded_server.GetDocumentCount() == static_cast<int>(corpus.size()),
+    "sharded document count", "differs from the model");
+
+  CompareWithReference(checker, "seq", reference, queries,
+    [&search_server](std::string_view query, DocumentStatus status) {
+      return search_server.FindTopDocuments(std::execution::seq, query,
+        status);
+    });
+  CompareWithReference(checker, "par", reference, queries,
+    [&search_server](std::string_view query, DocumentStatus status) {
+      return search_server.FindTopDocuments(std::execution::par, query,
+        status);
+    });
+
+  for (const DocumentStatus status : CHECKED_STATUSES) {
+    const auto batch = search_server.FindTopDocumentsBatch(
+      std::execution::par, queries, status);
+    for (size_t i = 0; i < queries.size(); ++i) {
+      checker.Compare("batch", queries[i], status,
+        reference.FindTopDocuments(std::execution::seq, queries[i], status),
+        batch[i]);
+    }
+  }
+
+  CompareWithReference(checker, "sharded", reference, queries,
+    [&sharded_server](std::string_view query, DocumentStatus status) {
+      return sharded_server.FindTopDocuments(std::execution::par, query,
+        status);
+    });
+
+  SearchServer compacted = search_server;
+  compacted.Compact();
+  CompareWithReference(checker, "Compact", reference, queries,
+    [&compacted](std::string_view query, DocumentStatus status) {
+      return compacted.FindTopDocuments(std::execution::seq, query, status);
+    });
+
+  SearchServer counted = search_server;
+  counted.SetTermFreqStorage(TermFreqStorage::COUNTS);
+  CompareWithReference(checker, "COUNTS", reference, queries,
+    [&counted](std::string_view query, DocumentStatus status) {
+      return counted.FindTopDocuments(std::execution::seq, query, status);
+    });
+
+  search_server.SaveSnapshot(snapshot_path);
+  const SearchServer restored = SearchServer::OpenSnapshot(snapshot_path);
+  CompareWithReference(checker, "snapshot", reference, queries,
+    [&restored](std::string_view query, DocumentStatus status) {
+      return restored.FindTopDocuments(std::execution::seq, query, status);
+    });
+
+  // Квантованный индекс: отсечение и снимок против полного перебора на нём же
+  SearchServer quantized = search_server;
+  quantized.SetImpactQuantization(ImpactQuantization::BITS_16);
+  quantized.SetQueryCacheCapacity(0);
+  SearchServer quantized_reference = quantized;
+  quantized_reference.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+  CompareWithReference(checker, "impact16", quantized_reference, queries,
+    [&quantized](std::string_view query, DocumentStatus status) {
+      return quantized.FindTopDocuments(std::execution::seq, query, status);
+    });
+
+  quantized.SaveSnapshot(snapshot_path);
+  const SearchServer quantized_restored =
+    SearchServer::OpenSnapshot(snapshot_path);
+  CompareWithReference(checker, "impact16 snapshot", quantized_reference,
+    queries,
+    [&quantized_restored](std::string_view query, DocumentStatus status) {
+      return quantized_restored.FindTopDocuments(std::execution::seq, query,
+        status);
+    });
+}
+
+}  // namespace
+
+int RunDifferentialTests(std::ostream &out) {
+  std::mt19937 generator;
+  Checker checker(out);
+
+  const auto dictionary = GenerateDictionary(generator, VOCABULARY_SIZE,
+    MAX_WORD_LENGTH);
+  const std::vector<std::string> stop_words(dictionary.begin(),
+    dictionary.begin() + STOP_WORD_COUNT);
+
+  // Одни и те же запросы задаются в каждом раунде
+  auto queries = GenerateQueries(generator, dictionary, QUERY_COUNT,
+    QUERY_WORD_COUNT, MINUS_PROB);
+  for (int i = 0; i < LONG_QUERY_COUNT; ++i) {
+    queries.push_back(GenerateQuery(generator, dictionary,
+      LONG_QUERY_WORD_COUNT, MINUS_PROB));
+  }
+
+  SearchServer search_server(stop_words);
+  search_server.SetQueryCacheCapacity(QUERY_CACHE_CAPACITY);
+  ShardedSearchServer sharded_server(stop_words, SHARD_COUNT);
+  Corpus corpus;
+
+  const std::string snapshot_path = (std::filesystem::temp_directory_path()
+    / "search_server_differential_test.snapshot").string();
+
+  int next_document_id = 0;
+  for (int round = 0; round < ROUND_COUNT; ++round) {
+    // Половина документов раунда добавляется пакетом, половина по одному
+    std::vector<DocumentInput> batch;
+    for (int i = 0; i < ROUND_DOCUMENT_COUNT; ++i) {
+      const int document_id = next_document_id++;
+      StoredDocument &document = corpus[document_id];
+      document.text = GenerateQuery(generator, dictionary,
+        std::uniform_int_distribution(1, DOCUMENT_WORD_COUNT)(generator));
+      document.status = static_cast<DocumentStatus>(
+        std::uniform_int_distribution(0, 3)(generator));
+      document.ratings = {std::uniform_int_distribution(-5, 5)(generator)};
+
+      sharded_server.AddDocument(document_id, document.text, document.status,
+        document.ratings);
+      if (i % 2 == 0) {
+        batch.push_back({document_id, document.text, document.status,
+          document.ratings});
+      } else {
+        search_server.AddDocument(document_id, document.text,
+          document.status, document.ratings);
+      }
+    }
+    search_server.AddDocuments(std::execution::par, batch);
+
+    CheckRejectedBatches(checker, generator, dictionary, search_server,
+      corpus, next_document_id);
+    CheckRound(checker, stop_words, corpus, search_server, sharded_server,
+      queries, snapshot_path);
+
+    // Удаления проверяются отдельно: кеш должен сбрасываться и без
+    // добавлений
+
+    std::vector<int> removed_ids;
+    for (const auto &[document_id, document] : corpus) {
+      if (std::uniform_int_distribution(0, 99)(generator) < REMOVED_PERCENT) {
+        removed_ids.push_back(document_id);
+      }
+    }
+    for (const int document_id : removed_ids) {
+      search_server.RemoveDocument(document_id);
+      sharded_server.RemoveDocument(document_id);
+      corpus.erase(document_id);
+    }
+
+    CheckRound(checker, stop_words, corpus, search_server, sharded_server,
+      queries, snapshot_path);
+  }
+
+  std::remove(snapshot_path.c_str());
+
+  out << "Differential tests: " << checker.GetFailureCount()
+    << " mismatches" << std::endl;
+  return checker.GetFailureCount();
+}
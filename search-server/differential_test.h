@@ -0,0 +1,22 @@
+#pragma once
+
+#include <ostream>
+
+/**
+ * Случайная сверка режимов поиска с эталоном. Корпус меняется по раундам:
+ * пакетные и одиночные добавления, отклоняемые пакеты, удаления. После
+ * каждого раунда эталоном служит сервер, заново построенный из живых
+ * документов и оценивающий запросы полным перебором, без кеша.
+ *
+ * С эталоном сверяются: отсечение block-max WAND с обеими политиками,
+ * пакетный поиск, шардированный сервер с общей статистикой IDF, сервер
+ * после Compact, после перехода на TermFreqStorage::COUNTS и после
+ * сохранения и загрузки снимка. Запросы повторяются между раундами, поэтому
+ * устаревший кеш результатов даёт расхождение. Отклонённый AddDocuments
+ * не должен менять индекс. Квантованные частоты приближённые, поэтому
+ * отсечение с ними сверяется с полным перебором на том же индексе.
+ *
+ * Генератор с фиксированным seed делает прогон воспроизводимым. Каждое
+ * расхождение выводится в out; возвращается их число.
+ */
+int RunDifferentialTests(std::ostream &out);
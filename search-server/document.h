@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document {
   Document() = default;
@@ -23,4 +25,13 @@ enum class DocumentStatus {
   REMOVED,
 };
 
+// Документ для пакетного добавления в SearchServer::AddDocuments. Текст
+// должен оставаться доступным до конца вызова
+struct DocumentInput {
+  int id = 0;
+  std::string_view text;
+  DocumentStatus status = DocumentStatus::ACTUAL;
+  std::vector<int> ratings;
+};
+
 std::ostream &operator<<(std::ostream &os, const Document document);
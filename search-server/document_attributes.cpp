@@ -0,0 +1,40 @@
+#include "document_attributes.h"
+
+void DocumentAttributes::Reserve(size_t size) {
+  ids_.reserve(size);
+  ratings_.reserve(size);
+  statuses_.reserve(size);
+  for (std::vector<uint64_t> &bitmap : status_bitmaps_) {
+    bitmap.reserve((size + 63) / 64);
+  }
+}
+
+void DocumentAttributes::Add(int id, int rating, DocumentStatus status) {
+  const int ordinal = static_cast<int>(ids_.size());
+  ids_.push_back(id);
+  ratings_.push_back(rating);
+  statuses_.push_back(static_cast<uint8_t>(status));
+
+  if (ordinal % 64 == 0) {
+    for (std::vector<uint64_t> &bitmap : status_bitmaps_) {
+      bitmap.push_back(0);
+    }
+  }
+  status_bitmaps_[static_cast<size_t>(status)][ordinal >> 6] |=
+    uint64_t{1} << (ordinal & 63);
+}
+
+void DocumentAttributes::Remove(int ordinal) {
+  status_bitmaps_[statuses_[ordinal]][ordinal >> 6] &=
+    ~(uint64_t{1} << (ordinal & 63));
+}
+
+size_t DocumentAttributes::GetMemoryUsage() const {
+  size_t bytes = ids_.capacity() * sizeof(int)
+    + ratings_.capacity() * sizeof(int)
+    + statuses_.capacity() * sizeof(uint8_t);
+  for (const std::vector<uint64_t> &bitmap : status_bitmaps_) {
+    bytes += bitmap.capacity() * sizeof(uint64_t);
+  }
+  return bytes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "document.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Число значений DocumentStatus
+const size_t DOCUMENT_STATUS_COUNT =
+  static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+
+/**
+ * Отбор документов по статусу. Эквивалентен лямбде
+ * [status](int, DocumentStatus s, int) { return s == status; }, но
+ * SearchServer распознаёт этот тип и проверяет статус по битовой карте,
+ * не читая атрибуты документа.
+ */
+struct DocumentStatusPredicate {
+  DocumentStatus status = DocumentStatus::ACTUAL;
+
+  bool operator()(int /*document_id*/, DocumentStatus document_status,
+    int /*rating*/) const {
+    return document_status == status;
+  }
+};
+
+template <typename Predicate>
+inline constexpr bool IS_STATUS_PREDICATE =
+  std::is_same_v<std::decay_t<Predicate>, DocumentStatusPredicate>;
+
+/**
+ * Атрибуты документов по порядковому номеру, хранящиеся столбцами:
+ * идентификаторы, рейтинги и статусы в отдельных плотных массивах. Для
+ * каждого статуса есть битовая карта неудалённых документов с этим
+ * статусом, поэтому отбор по статусу - проверка бита, а объединение карт
+ * задаёт множество неудалённых документов.
+ */
+class DocumentAttributes {
+public:
+  [[nodiscard]] size_t size() const {
+    return ids_.size();
+  }
+
+  void Reserve(size_t size);
+
+  // Добавляет документ с номером size()
+  void Add(int id, int rating, DocumentStatus status);
+
+  // Отмечает документ удалённым; его атрибуты остаются доступны
+  void Remove(int ordinal);
+
+  [[nodiscard]] int GetId(int ordinal) const {
+    return ids_[ordinal];
+  }
+
+  [[nodiscard]] int GetRating(int ordinal) const {
+    return ratings_[ordinal];
+  }
+
+  [[nodiscard]] DocumentStatus GetStatus(int ordinal) const {
+    return static_cast<DocumentStatus>(statuses_[ordinal]);
+  }
+
+  // Документ не удалён и имеет статус status
+  [[nodiscard]] bool HasStatus(int ordinal, DocumentStatus status) const {
+    return TestBit(status_bitmaps_[static_cast<size_t>(status)], ordinal);
+  }
+
+  [[nodiscard]] bool IsLive(int ordinal) const {
+    return HasStatus(ordinal, GetStatus(ordinal));
+  }
+
+  // Битовая карта статуса: бит ordinal % 64 слова ordinal / 64
+  [[nodiscard]] const std::vector<uint64_t> &GetStatusBitmap(
+    DocumentStatus status) const {
+    return status_bitmaps_[static_cast<size_t>(status)];
+  }
+
+  static bool TestBit(const std::vector<uint64_t> &bitmap, int ordinal) {
+    return (bitmap[ordinal >> 6] >> (ordinal & 63)) & 1;
+  }
+
+  // Память, занятая столбцами и битовыми картами
+  [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+  std::vector<int> ids_;
+  std::vector<int> ratings_;
+  std::vector<uint8_t> statuses_;
+  std::array<std::vector<uint64_t>, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+};
@@ -0,0 +1,142 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+
+void DocumentBitmap::Add(int ordinal) {
+  const auto key = static_cast<uint32_t>(ordinal) >> 16;
+  const auto value = static_cast<uint16_t>(ordinal);
+
+  auto it = !containers_.empty() && containers_.back().key == key
+    ? containers_.end() - 1
+    : FindContainer(key);
+  if (it == containers_.end() || it->key != key) {
+    it = containers_.insert(it, Container());
+    it->key = key;
+  }
+
+  if (it->Add(value)) {
+    ++size_;
+  }
+}
+
+void DocumentBitmap::Remove(int ordinal) {
+  const auto key = static_cast<uint32_t>(ordinal) >> 16;
+  const auto it = FindContainer(key);
+  if (it == containers_.end() || it->key != key) {
+    return;
+  }
+
+  if (it->Remove(static_cast<uint16_t>(ordinal))) {
+    --size_;
+    if (it->size == 0) {
+      containers_.erase(it);
+    }
+  }
+}
+
+bool DocumentBitmap::Contains(int ordinal) const {
+  const auto key = static_cast<uint32_t>(ordinal) >> 16;
+  const auto it = FindContainer(key);
+  return it != containers_.end() && it->key == key
+    && it->Contains(static_cast<uint16_t>(ordinal));
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+  size_t bytes = containers_.capacity() * sizeof(Container);
+  for (const Container &container : containers_) {
+    bytes += container.values.capacity() * sizeof(uint16_t)
+      + container.words.capacity() * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+std::vector<DocumentBitmap::Container>::iterator
+DocumentBitmap::FindContainer(uint32_t key) {
+  return std::lower_bound(containers_.begin(), containers_.end(), key,
+    [](const Container &container, uint32_t value) {
+      return container.key < value;
+    });
+}
+
+std::vector<DocumentBitmap::Container>::const_iterator
+DocumentBitmap::FindContainer(uint32_t key) const {
+  return std::lower_bound(containers_.begin(), containers_.end(), key,
+    [](const Container &container, uint32_t value) {
+      return container.key < value;
+    });
+}
+
+bool DocumentBitmap::Container::Contains(uint16_t value) const {
+  if (IsBitmap()) {
+    return (words[value >> 6] >> (value & 63)) & 1;
+  }
+  return std::binary_search(values.begin(), values.end(), value);
+}
+
+bool DocumentBitmap::Container::Add(uint16_t value) {
+  if (IsBitmap()) {
+    const uint64_t bit = uint64_t{1} << (value & 63);
+    if (words[value >> 6] & bit) {
+      return false;
+    }
+    words[value >> 6] |= bit;
+    ++size;
+    return true;
+  }
+
+  if (values.empty() || values.back() < value) {
+    values.push_back(value);
+  } else {
+    const auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (*it == value) {
+      return false;
+    }
+    values.insert(it, value);
+  }
+
+  if (++size > ARRAY_CONTAINER_MAX_SIZE) {
+    ToBitmap();
+  }
+  return true;
+}
+
+bool DocumentBitmap::Container::Remove(uint16_t value) {
+  if (IsBitmap()) {
+    const uint64_t bit = uint64_t{1} << (value & 63);
+    if (!(words[value >> 6] & bit)) {
+      return false;
+    }
+    words[value >> 6] &= ~bit;
+    if (--size <= ARRAY_CONTAINER_MAX_SIZE / 2) {
+      ToArray();
+    }
+    return true;
+  }
+
+  const auto it = std::lower_bound(values.begin(), values.end(), value);
+  if (it == values.end() || *it != value) {
+    return false;
+  }
+  values.erase(it);
+  --size;
+  return true;
+}
+
+void DocumentBitmap::Container::ToBitmap() {
+  words.assign(BITMAP_WORD_COUNT, 0);
+  for (const uint16_t value : values) {
+    words[value >> 6] |= uint64_t{1} << (value & 63);
+  }
+  values = std::vector<uint16_t>();
+}
+
+void DocumentBitmap::Container::ToArray() {
+  values.clear();
+  values.reserve(size);
+  for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i) {
+    for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+      values.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+    }
+  }
+  words = std::vector<uint64_t>();
+}
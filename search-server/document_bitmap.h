@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Сжатое множество порядковых номеров документов в духе Roaring bitmap.
+ * Номера делятся на диапазоны по 2^16 по старшим битам, каждый непустой
+ * диапазон хранится контейнером одного из двух видов:
+ *  - массив: отсортированные младшие 16 бит, пока номеров не больше
+ *    ARRAY_CONTAINER_MAX_SIZE (2 байта на номер);
+ *  - битовая карта на 2^16 бит (8 КиБ) для более плотных диапазонов.
+ * Массив становится битовой картой при превышении порога, а обратно -
+ * когда номеров остаётся вдвое меньше порога, чтобы чередование добавлений
+ * и удалений не перестраивало контейнер.
+ *
+ * Проверка номера - двоичный поиск контейнера и бит или двоичный поиск в
+ * массиве не длиннее ARRAY_CONTAINER_MAX_SIZE.
+ */
+class DocumentBitmap {
+public:
+  static const size_t ARRAY_CONTAINER_MAX_SIZE = 4096;
+
+  // Добавление номеров по возрастанию не требует поиска контейнера
+  void Add(int ordinal);
+  void Remove(int ordinal);
+
+  [[nodiscard]] bool Contains(int ordinal) const;
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+
+  // Память, занятая контейнерами
+  [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+  static const size_t BITMAP_WORD_COUNT = (1 << 16) / 64;
+
+  struct Container {
+    // Старшие 16 бит номеров контейнера
+    uint32_t key = 0;
+    uint32_t size = 0;
+    // Младшие биты по возрастанию; пуст, если контейнер - битовая карта
+    std::vector<uint16_t> values;
+    // BITMAP_WORD_COUNT слов или пусто, если контейнер - массив
+    std::vector<uint64_t> words;
+
+    bool IsBitmap() const {
+      return !words.empty();
+    }
+
+    bool Contains(uint16_t value) const;
+    // Возвращают false, если состав не изменился
+    bool Add(uint16_t value);
+    bool Remove(uint16_t value);
+    void ToBitmap();
+    void ToArray();
+  };
+
+  // Контейнеры по возрастанию ключа
+  std::vector<Container> containers_;
+  size_t size_ = 0;
+
+  std::vector<Container>::iterator FindContainer(uint32_t key);
+  std::vector<Container>::const_iterator FindContainer(uint32_t key) const;
+};
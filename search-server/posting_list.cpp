@@ -0,0 +1,556 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Квантует частоты относительно наибольшей частоты блока и возвращает
+// частоту, соответствующую единице квантованного значения
+template <typename Impact>
+double QuantizeTermFreqs(const double *term_freqs, Impact *impacts,
+  size_t count, double max_term_freq) {
+  const double max_impact = std::numeric_limits<Impact>::max();
+  for (size_t i = 0; i < count; ++i) {
+    impacts[i] = static_cast<Impact>(
+      std::lround(term_freqs[i] / max_term_freq * max_impact));
+  }
+  return max_term_freq / max_impact;
+}
+
+// Сдвигает элементы [first + 1, last) на одну позицию влево; пустой массив
+// не используется при текущем способе хранения и не меняется
+template <typename T>
+void ShiftLeft(std::vector<T> &values, size_t first, size_t last) {
+  if (!values.empty()) {
+    std::copy(values.begin() + first + 1, values.begin() + last,
+      values.begin() + first);
+  }
+}
+
+template <typename T>
+void Truncate(std::vector<T> &values, size_t size) {
+  if (values.size() > size) {
+    values.resize(size);
+  }
+}
+
+}  // namespace
+
+void PostingList::PushBack(int ordinal, uint32_t count,
+  uint32_t word_count) {
+  Append(ordinal, static_cast<double>(count) / word_count, count, word_count);
+}
+
+void PostingList::Append(int ordinal, double term_freq, uint32_t count,
+  uint32_t word_count) {
+  // Квантованные частоты блока пересчитываются, только если меняется его
+  // наибольшая частота
+  bool is_rescaled = true;
+  if (blocks_.empty() || blocks_.back().size == BLOCK_SIZE) {
+    blocks_.push_back({
+      ordinal,
+      ordinal,
+      static_cast<uint32_t>(deltas_.size()),
+      static_cast<uint32_t>(GetStorageSize()),
+      1,
+      term_freq,
+      0.0
+    });
+  } else {
+    Block &block = blocks_.back();
+    WriteVarint(deltas_, static_cast<uint32_t>(ordinal - block.last_ordinal));
+    block.last_ordinal = ordinal;
+    ++block.size;
+    is_rescaled = term_freq > block.max_term_freq;
+    block.max_term_freq = std::max(block.max_term_freq, term_freq);
+  }
+
+  if (storage_ == TermFreqStorage::COUNTS) {
+    counts_.push_back(static_cast<uint16_t>(count));
+    word_counts_.push_back(static_cast<uint16_t>(word_count));
+  } else {
+    term_freqs_.push_back(term_freq);
+  }
+  max_term_freq_ = std::max(max_term_freq_, term_freq);
+  ++size_;
+  UpdateLogSize();
+
+  if (has_bitmap_) {
+    bitmap_.Add(ordinal);
+  } else if (size() == MIN_BITMAP_SIZE) {
+    BuildBitmap();
+  }
+
+  if (quantization_ == ImpactQuantization::BITS_8) {
+    impacts8_.push_back(0);
+  } else if (quantization_ == ImpactQuantization::BITS_16) {
+    impacts16_.push_back(0);
+  } else {
+    return;
+  }
+
+  if (is_rescaled) {
+    QuantizeBlock(blocks_.size() - 1);
+  } else if (quantization_ == ImpactQuantization::BITS_8) {
+    QuantizeTermFreqs(&term_freq, &impacts8_.back(), 1,
+      blocks_.back().max_term_freq);
+  } else {
+    QuantizeTermFreqs(&term_freq, &impacts16_.back(), 1,
+      blocks_.back().max_term_freq);
+  }
+}
+
+bool PostingList::Erase(int ordinal) {
+  const size_t block_index = FindBlock(ordinal);
+  if (block_index == blocks_.size()) {
+    return false;
+  }
+
+  std::array<int, BLOCK_SIZE> ordinals;
+  size_t count = DecodeBlock(block_index, ordinals.data());
+  const auto it = std::lower_bound(ordinals.begin(), ordinals.begin() + count,
+    ordinal);
+  if (it == ordinals.begin() + count || *it != ordinal) {
+    return false;
+  }
+  std::copy(it + 1, ordinals.begin() + count, it);
+  --count;
+
+  // Вхождения блока после удалённого сдвигаются на его место, последнее
+  // место блока освобождается
+  Block &block = blocks_[block_index];
+  const size_t index = block.begin + (it - ordinals.begin());
+  const size_t block_end = block.begin + block.size;
+  const double term_freq = GetExactTermFreq(index);
+  ShiftLeft(term_freqs_, index, block_end);
+  ShiftLeft(counts_, index, block_end);
+  ShiftLeft(word_counts_, index, block_end);
+  ShiftLeft(impacts8_, index, block_end);
+  ShiftLeft(impacts16_, index, block_end);
+
+  // Новые разности не длиннее прежних и записываются на их место
+  uint8_t *data = deltas_.data() + block.offset;
+  for (size_t i = 1; i < count; ++i) {
+    data = WriteVarint(data,
+      static_cast<uint32_t>(ordinals[i] - ordinals[i - 1]));
+  }
+
+  const bool is_last_block = block_index + 1 == blocks_.size();
+  // Наибольшая частота блока после удаления
+  double block_max_term_freq = 0.0;
+  if (count == 0) {
+    blocks_.erase(blocks_.begin() + block_index);
+  } else {
+    block.first_ordinal = ordinals[0];
+    block.last_ordinal = ordinals[count - 1];
+    block.size = static_cast<uint32_t>(count);
+
+    if (term_freq >= block.max_term_freq) {
+      block.max_term_freq = 0.0;
+      for (size_t i = block.begin; i < block.begin + block.size; ++i) {
+        block.max_term_freq = std::max(block.max_term_freq,
+          GetExactTermFreq(i));
+      }
+      QuantizeBlock(block_index);
+    }
+    block_max_term_freq = block.max_term_freq;
+  }
+  if (is_last_block) {
+    TrimStorage();
+  }
+
+  // Остальные блоки просматриваются, только если удалена наибольшая частота
+  // списка и в блоке её больше нет
+  if (term_freq >= max_term_freq_ && block_max_term_freq < max_term_freq_) {
+    max_term_freq_ = 0.0;
+    for (const Block &el : blocks_) {
+      max_term_freq_ = std::max(max_term_freq_, el.max_term_freq);
+    }
+  }
+  --size_;
+  UpdateLogSize();
+
+  if (has_bitmap_) {
+    if (size() < MIN_BITMAP_SIZE / 2) {
+      has_bitmap_ = false;
+      bitmap_ = DocumentBitmap();
+    } else {
+      bitmap_.Remove(ordinal);
+    }
+  }
+
+  // Перестроение стоит O(size()), но происходит не чаще, чем раз в size()
+  // удалений
+  if (GetStorageSize() > 2 * size()) {
+    *this = Rebuild([](int ordinal) {
+      return ordinal;
+    });
+  }
+
+  return true;
+}
+
+bool PostingList::Contains(int ordinal) const {
+  if (has_bitmap_) {
+    return bitmap_.Contains(ordinal);
+  }
+  return PostingCursor(*this).Contains(ordinal);
+}
+
+void PostingList::SetImpactQuantization(ImpactQuantization quantization) {
+  quantization_ = quantization;
+  impacts8_ = std::vector<uint8_t>();
+  impacts16_ = std::vector<uint16_t>();
+
+  if (quantization_ == ImpactQuantization::BITS_8) {
+    impacts8_.resize(GetStorageSize());
+  } else if (quantization_ == ImpactQuantization::BITS_16) {
+    impacts16_.resize(GetStorageSize());
+  }
+  for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+    QuantizeBlock(block_index);
+  }
+}
+
+PostingList PostingList::Renumber(const std::vector<int> &new_ordinals) const {
+  return Rebuild([&new_ordinals](int ordinal) {
+    return new_ordinals[ordinal];
+  });
+}
+
+template <typename Function>
+PostingList PostingList::Rebuild(Function new_ordinal) const {
+  // Блоки заполняются заново, поэтому неполные блоки после Erase сливаются
+  // и заново квантуются по точным частотам
+  PostingList result;
+  result.quantization_ = quantization_;
+  result.storage_ = storage_;
+  std::array<int, BLOCK_SIZE> ordinals;
+
+  for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+    const size_t count = DecodeBlock(block_index, ordinals.data());
+    const size_t begin = blocks_[block_index].begin;
+    for (size_t i = 0; i < count; ++i) {
+      const int ordinal = new_ordinal(ordinals[i]);
+      if (ordinal < 0) {
+        continue;
+      }
+      if (storage_ == TermFreqStorage::COUNTS) {
+        result.Append(ordinal, GetExactTermFreq(begin + i),
+          counts_[begin + i], word_counts_[begin + i]);
+      } else {
+        result.Append(ordinal, term_freqs_[begin + i], 0, 0);
+      }
+    }
+  }
+  result.blocks_.shrink_to_fit();
+  result.deltas_.shrink_to_fit();
+  result.term_freqs_.shrink_to_fit();
+  result.counts_.shrink_to_fit();
+  result.word_counts_.shrink_to_fit();
+  result.impacts8_.shrink_to_fit();
+  result.impacts16_.shrink_to_fit();
+  return result;
+}
+
+void PostingList::SetTermFreqStorage(TermFreqStorage storage) {
+  if (!empty()) {
+    throw std::logic_error("Term frequency storage of a non-empty list");
+  }
+  storage_ = storage;
+}
+
+size_t PostingList::GetMemoryUsage() const {
+  return blocks_.capacity() * sizeof(Block)
+    + deltas_.capacity() * sizeof(uint8_t)
+    + term_freqs_.capacity() * sizeof(double)
+    + (counts_.capacity() + word_counts_.capacity()) * sizeof(uint16_t)
+    + impacts8_.capacity() * sizeof(uint8_t)
+    + impacts16_.capacity() * sizeof(uint16_t)
+    + bitmap_.GetMemoryUsage();
+}
+
+void PostingList::Save(SnapshotWriter &writer) const {
+  std::vector<int> first_ordinals;
+  std::vector<int> last_ordinals;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> begins;
+  std::vector<uint32_t> sizes;
+  std::vector<double> max_term_freqs;
+
+  for (const Block &block : blocks_) {
+    first_ordinals.push_back(block.first_ordinal);
+    last_ordinals.push_back(block.last_ordinal);
+    offsets.push_back(block.offset);
+    begins.push_back(block.begin);
+    sizes.push_back(block.size);
+    max_term_freqs.push_back(block.max_term_freq);
+  }
+
+  writer.WriteArray(first_ordinals);
+  writer.WriteArray(last_ordinals);
+  writer.WriteArray(offsets);
+  writer.WriteArray(begins);
+  writer.WriteArray(sizes);
+  writer.WriteArray(max_term_freqs);
+  writer.WriteArray(deltas_);
+  writer.Write(static_cast<int32_t>(storage_));
+  if (storage_ == TermFreqStorage::COUNTS) {
+    writer.WriteArray(counts_);
+    writer.WriteArray(word_counts_);
+  } else {
+    writer.WriteArray(term_freqs_);
+  }
+  writer.Write(max_term_freq_);
+}
+
+PostingList PostingList::Load(SnapshotReader &reader) {
+  std::vector<int> first_ordinals;
+  std::vector<int> last_ordinals;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> begins;
+  std::vector<uint32_t> sizes;
+  std::vector<double> max_term_freqs;
+
+  reader.ReadArray(first_ordinals);
+  reader.ReadArray(last_ordinals);
+  reader.ReadArray(offsets);
+  reader.ReadArray(begins);
+  reader.ReadArray(sizes);
+  reader.ReadArray(max_term_freqs);
+
+  PostingList postings;
+  reader.ReadArray(postings.deltas_);
+  const auto storage = reader.Read<int32_t>();
+  size_t term_freq_count = 0;
+  if (storage == static_cast<int32_t>(TermFreqStorage::COUNTS)) {
+    postings.storage_ = TermFreqStorage::COUNTS;
+    reader.ReadArray(postings.counts_);
+    reader.ReadArray(postings.word_counts_);
+    term_freq_count = postings.counts_.size();
+    if (postings.word_counts_.size() != term_freq_count
+      || std::find(postings.word_counts_.begin(), postings.word_counts_.end(),
+        0) != postings.word_counts_.end()) {
+      throw std::runtime_error("Snapshot file is corrupted");
+    }
+  } else if (storage == static_cast<int32_t>(TermFreqStorage::DOUBLE)) {
+    reader.ReadArray(postings.term_freqs_);
+    term_freq_count = postings.term_freqs_.size();
+  } else {
+    throw std::runtime_error("Snapshot file is corrupted");
+  }
+  postings.max_term_freq_ = reader.Read<double>();
+
+  const size_t block_count = first_ordinals.size();
+  if (last_ordinals.size() != block_count || offsets.size() != block_count
+    || begins.size() != block_count || sizes.size() != block_count
+    || max_term_freqs.size() != block_count) {
+    throw std::runtime_error("Snapshot file is corrupted");
+  }
+
+  postings.blocks_.reserve(block_count);
+  for (size_t i = 0; i < block_count; ++i) {
+    postings.blocks_.push_back({
+      first_ordinals[i],
+      last_ordinals[i],
+      offsets[i],
+      begins[i],
+      sizes[i],
+      max_term_freqs[i],
+      0.0
+    });
+  }
+  if (postings.GetStorageSize() != term_freq_count) {
+    throw std::runtime_error("Snapshot file is corrupted");
+  }
+  for (const Block &block : postings.blocks_) {
+    postings.size_ += block.size;
+  }
+  postings.UpdateLogSize();
+  if (postings.size() >= MIN_BITMAP_SIZE) {
+    postings.BuildBitmap();
+  }
+
+  return postings;
+}
+
+void PostingList::WriteVarint(std::vector<uint8_t> &out, uint32_t value) {
+  while (value >= 0x80u) {
+    out.push_back(static_cast<uint8_t>(value | 0x80u));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+uint8_t *PostingList::WriteVarint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80u) {
+    *out++ = static_cast<uint8_t>(value | 0x80u);
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+size_t PostingList::FindBlock(int ordinal) const {
+  const size_t block_index = LowerBoundBlock(0, ordinal);
+
+  if (block_index == blocks_.size()
+    || blocks_[block_index].first_ordinal > ordinal) {
+    return blocks_.size();
+  }
+
+  return block_index;
+}
+
+size_t PostingList::GetEncodedEnd(size_t block_index) const {
+  const Block &block = blocks_[block_index];
+  const uint8_t *data = deltas_.data() + block.offset;
+  for (uint32_t i = 1; i < block.size; ++i) {
+    ReadVarint(data);
+  }
+  return data - deltas_.data();
+}
+
+void PostingList::TrimStorage() {
+  const size_t size = GetStorageSize();
+  Truncate(term_freqs_, size);
+  Truncate(counts_, size);
+  Truncate(word_counts_, size);
+  Truncate(impacts8_, size);
+  Truncate(impacts16_, size);
+  deltas_.resize(blocks_.empty() ? 0 : GetEncodedEnd(blocks_.size() - 1));
+}
+
+size_t PostingList::LowerBoundBlock(size_t from, int ordinal) const {
+  return std::lower_bound(blocks_.begin() + from, blocks_.end(), ordinal,
+    [](const Block &block, int value) {
+      return block.last_ordinal < value;
+    }) - blocks_.begin();
+}
+
+std::vector<int> PostingList::DecodeBlock(size_t block_index) const {
+  std::vector<int> ordinals(blocks_[block_index].size);
+  DecodeBlock(block_index, ordinals.data());
+  return ordinals;
+}
+
+size_t PostingList::DecodeBlock(size_t block_index, int *ordinals) const {
+  const Block &block = blocks_[block_index];
+  const uint8_t *data = deltas_.data() + block.offset;
+  int ordinal = block.first_ordinal;
+  ordinals[0] = ordinal;
+
+  for (uint32_t i = 1; i < block.size; ++i) {
+    ordinal += static_cast<int>(ReadVarint(data));
+    ordinals[i] = ordinal;
+  }
+
+  return block.size;
+}
+
+void PostingList::BuildBitmap() {
+  has_bitmap_ = true;
+  bitmap_ = DocumentBitmap();
+  std::array<int, BLOCK_SIZE> ordinals;
+  for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+    const size_t count = DecodeBlock(block_index, ordinals.data());
+    for (size_t i = 0; i < count; ++i) {
+      bitmap_.Add(ordinals[i]);
+    }
+  }
+}
+
+void PostingList::UpdateLogSize() {
+  log_size_ = empty() ? 0.0 : std::log(static_cast<double>(size()));
+}
+
+void PostingList::QuantizeBlock(size_t block_index) {
+  Block &block = blocks_[block_index];
+  if (quantization_ == ImpactQuantization::EXACT) {
+    block.impact_step = 0.0;
+    return;
+  }
+
+  std::array<double, BLOCK_SIZE> term_freqs;
+  for (size_t i = 0; i < block.size; ++i) {
+    term_freqs[i] = GetExactTermFreq(block.begin + i);
+  }
+
+  if (quantization_ == ImpactQuantization::BITS_8) {
+    block.impact_step = QuantizeTermFreqs(term_freqs.data(),
+      impacts8_.data() + block.begin, block.size, block.max_term_freq);
+  } else {
+    block.impact_step = QuantizeTermFreqs(term_freqs.data(),
+      impacts16_.data() + block.begin, block.size, block.max_term_freq);
+  }
+}
+
+PostingCursor::PostingCursor(const PostingList &postings)
+  : postings_(&postings) {
+  EnterBlock(0);
+}
+
+void PostingCursor::Next() {
+  const PostingList::Block &block = postings_->blocks_[block_];
+
+  if (++position_ < block.begin + block.size) {
+    ordinal_ += static_cast<int>(PostingList::ReadVarint(data_));
+  } else {
+    EnterBlock(block_ + 1);
+  }
+}
+
+void PostingCursor::AdvanceTo(int ordinal) {
+  if (ordinal <= ordinal_) {
+    return;
+  }
+
+  if (postings_->blocks_[block_].last_ordinal < ordinal) {
+    EnterBlock(postings_->LowerBoundBlock(block_ + 1, ordinal));
+  }
+
+  while (ordinal_ < ordinal) {
+    Next();
+  }
+}
+
+void PostingCursor::AdvanceShallowTo(int ordinal) {
+  shallow_block_ = postings_->LowerBoundBlock(shallow_block_, ordinal);
+}
+
+double PostingCursor::GetBlockMaxTermFreq(int ordinal) const {
+  if (shallow_block_ == postings_->blocks_.size()) {
+    return 0.0;
+  }
+
+  const PostingList::Block &block = postings_->blocks_[shallow_block_];
+  return block.first_ordinal <= ordinal ? block.max_term_freq : 0.0;
+}
+
+int PostingCursor::GetBlockBoundary(int ordinal) const {
+  if (shallow_block_ == postings_->blocks_.size()) {
+    return END;
+  }
+
+  const PostingList::Block &block = postings_->blocks_[shallow_block_];
+  return block.first_ordinal <= ordinal
+    ? block.last_ordinal + 1
+    : block.first_ordinal;
+}
+
+void PostingCursor::EnterBlock(size_t block_index) {
+  block_ = block_index;
+  shallow_block_ = std::max(shallow_block_, block_);
+
+  if (block_ == postings_->blocks_.size()) {
+    position_ = postings_->GetStorageSize();
+    ordinal_ = END;
+    return;
+  }
+
+  const PostingList::Block &block = postings_->blocks_[block_];
+  position_ = block.begin;
+  data_ = postings_->deltas_.data() + block.offset;
+  ordinal_ = block.first_ordinal;
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "document_bitmap.h"
+#include "snapshot_io.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Квантование частот терма в списках вхождений. Кроме точных частот список
+ * хранит их приближения: частота tf в блоке с наибольшей частотой m
+ * заменяется целым q = round(tf / m * Q), Q = 2^bits - 1, и при оценке
+ * восстанавливается как q * (m / Q). Вклад слова tf * idf в релевантность
+ * получается как q * (m / Q) * idf, то есть квантованный вклад отличается
+ * от точного не больше чем на idf * m / (2 * Q) <= idf / (2 * Q): на
+ * idf / 510 при 8 битах и на idf / 131070 при 16 битах. Документы, чья
+ * релевантность различается меньше суммы этих границ по словам запроса,
+ * могут поменяться местами.
+ *
+ * Масштаб m / Q свой у каждого блока и не зависит от IDF, поэтому
+ * добавление и удаление документов перекодирует не больше одного блока
+ * каждого затронутого списка.
+ */
+enum class ImpactQuantization {
+  // Оценка по точным частотам
+  EXACT,
+  BITS_16,
+  BITS_8,
+};
+
+/**
+ * Хранение точных частот терма в списке вхождений. COUNTS хранит вместо
+ * double число вхождений терма и длину документа (по 16 бит) и вычисляет
+ * частоту делением при чтении; результат деления совпадает с частотой,
+ * которую хранит DOUBLE, поэтому способ хранения не влияет на поиск.
+ * COUNTS вдвое экономнее, но требует, чтобы в документах было не больше
+ * MAX_COUNTED_WORD_COUNT слов.
+ */
+enum class TermFreqStorage {
+  DOUBLE,
+  COUNTS,
+};
+
+const uint32_t MAX_COUNTED_WORD_COUNT = std::numeric_limits<uint16_t>::max();
+
+/**
+ * Список вхождений терма (postings list).
+ *
+ * Документы в списке идут по возрастанию внутреннего порядкового номера
+ * (ordinal) и разбиты на блоки по BLOCK_SIZE вхождений. Внутри блока номера
+ * хранятся разностями от предыдущего номера в формате varint, первый номер
+ * блока лежит в его заголовке. Частоты терма хранятся отдельным непрерывным
+ * массивом в том же порядке, что и номера документов.
+ *
+ * Удаление вхождения сдвигает данные только внутри его блока, а в конце
+ * блока остаётся неиспользуемое место. Список перестраивается целиком,
+ * когда таких мест становится больше, чем вхождений.
+ */
+class PostingList {
+public:
+  static const size_t BLOCK_SIZE = 128;
+  // Списки не короче хранят номера документов ещё и битовой картой
+  static const size_t MIN_BITMAP_SIZE = 1024;
+
+  // Добавляет вхождение в конец списка: терм встречается count раз среди
+  // word_count слов документа. Номер документа должен быть больше всех
+  // номеров, добавленных ранее; при TermFreqStorage::COUNTS word_count не
+  // больше MAX_COUNTED_WORD_COUNT
+  void PushBack(int ordinal, uint32_t count, uint32_t word_count);
+
+  // Удаляет вхождение документа. Возвращает false, если документа в списке
+  // не было. Стоимость пропорциональна размеру блока, кроме удаления
+  // наибольшей частоты списка и редких перестроений списка
+  bool Erase(int ordinal);
+
+  // Список с перенумерованными документами: new_ordinals[ordinal] задаёт
+  // новый номер, -1 исключает документ. Новые номера должны сохранять
+  // порядок старых
+  [[nodiscard]] PostingList Renumber(const std::vector<int> &new_ordinals) const;
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return blocks_.empty();
+  }
+
+  // Задаёт хранение частот пустого списка
+  void SetTermFreqStorage(TermFreqStorage storage);
+
+  [[nodiscard]] TermFreqStorage GetTermFreqStorage() const {
+    return storage_;
+  }
+
+  // Наибольшая частота терма в списке; верхняя граница вклада терма
+  // в релевантность любого документа
+  [[nodiscard]] double GetMaxTermFreq() const {
+    return max_term_freq_;
+  }
+
+  // Натуральный логарифм числа вхождений непустого списка; обновляется при
+  // изменении списка, чтобы IDF не вычислялся заново для каждого запроса
+  [[nodiscard]] double GetLogSize() const {
+    return log_size_;
+  }
+
+  // Включает оценку по квантованным частотам или возвращает точную.
+  // Точные частоты хранятся всегда, поэтому переключение не теряет точности
+  void SetImpactQuantization(ImpactQuantization quantization);
+
+  [[nodiscard]] ImpactQuantization GetImpactQuantization() const {
+    return quantization_;
+  }
+
+  // Для вхождений с номерами из [begin, end) вызывает по частям блоков
+  // func(ordinals, impacts, count, step): номера документов и квантованные
+  // частоты лежат в непрерывных массивах, частота i-го вхождения равна
+  // impacts[i] * step. Impact - uint8_t для BITS_8 и uint16_t для BITS_16.
+  // Обход прекращается, если func вернула false; тогда результат - false
+  template <typename Impact, typename Function>
+  bool ForEachImpactBlock(int begin, int end, Function func) const;
+
+  // Номера документов списка для проверки принадлежности без обхода
+  // вхождений. Карта хранится у списков из MIN_BITMAP_SIZE вхождений и
+  // более и удаляется, когда их становится вдвое меньше; у остальных
+  // списков - nullptr
+  [[nodiscard]] const DocumentBitmap *GetDocumentBitmap() const {
+    return has_bitmap_ ? &bitmap_ : nullptr;
+  }
+
+  // Документ есть в списке
+  [[nodiscard]] bool Contains(int ordinal) const;
+
+  // Память, занятая списком и его битовой картой
+  [[nodiscard]] size_t GetMemoryUsage() const;
+
+  // Список сохраняется в том же блочном виде, в котором хранится в памяти,
+  // вместе со способом хранения частот
+  void Save(SnapshotWriter &writer) const;
+  static PostingList Load(SnapshotReader &reader);
+
+private:
+  friend class PostingCursor;
+
+  struct Block {
+    int first_ordinal;
+    int last_ordinal;
+    // Смещение закодированных разностей блока в deltas_
+    uint32_t offset;
+    // Индекс первого вхождения блока в массивах частот. После удалений
+    // между блоками могут оставаться неиспользуемые места
+    uint32_t begin;
+    uint32_t size;
+    double max_term_freq;
+    // Частота, соответствующая единице квантованного значения
+    double impact_step;
+  };
+
+  std::vector<Block> blocks_;
+  std::vector<uint8_t> deltas_;
+  size_t size_ = 0;
+  TermFreqStorage storage_ = TermFreqStorage::DOUBLE;
+  // Частоты при DOUBLE
+  std::vector<double> term_freqs_;
+  // Число вхождений терма и длина документа при COUNTS
+  std::vector<uint16_t> counts_;
+  std::vector<uint16_t> word_counts_;
+  double max_term_freq_ = 0.0;
+  double log_size_ = 0.0;
+  ImpactQuantization quantization_ = ImpactQuantization::EXACT;
+  // Квантованные частоты в порядке вхождений; заполнен один из массивов
+  std::vector<uint8_t> impacts8_;
+  std::vector<uint16_t> impacts16_;
+  bool has_bitmap_ = false;
+  DocumentBitmap bitmap_;
+
+  static void WriteVarint(std::vector<uint8_t> &out, uint32_t value);
+  // Записывает значение в out и возвращает конец записи
+  static uint8_t *WriteVarint(uint8_t *out, uint32_t value);
+  static uint32_t ReadVarint(const uint8_t *&data);
+
+  // Индекс блока, который может содержать ordinal, либо blocks_.size()
+  [[nodiscard]] size_t FindBlock(int ordinal) const;
+  // Конец закодированных разностей блока в deltas_
+  [[nodiscard]] size_t GetEncodedEnd(size_t block_index) const;
+  // Размер массивов частот вместе с неиспользуемыми местами
+  [[nodiscard]] size_t GetStorageSize() const {
+    return blocks_.empty() ? 0 : blocks_.back().begin + blocks_.back().size;
+  }
+  // Отбрасывает неиспользуемые места после последнего блока
+  void TrimStorage();
+  // Список из вхождений этого с номерами new_ordinal(ordinal); вхождения
+  // с отрицательным новым номером пропускаются
+  template <typename Function>
+  [[nodiscard]] PostingList Rebuild(Function new_ordinal) const;
+  [[nodiscard]] std::vector<int> DecodeBlock(size_t block_index) const;
+  void BuildBitmap();
+  // Записывает номера документов блока в ordinals, возвращает их число
+  size_t DecodeBlock(size_t block_index, int *ordinals) const;
+  // Индекс первого блока, начиная с from, у которого last_ordinal >= ordinal
+  [[nodiscard]] size_t LowerBoundBlock(size_t from, int ordinal) const;
+
+  // Добавляет вхождение; count и word_count используются при COUNTS
+  void Append(int ordinal, double term_freq, uint32_t count,
+    uint32_t word_count);
+  void UpdateLogSize();
+  // Пересчитывает масштаб и квантованные частоты блока по точным частотам
+  void QuantizeBlock(size_t block_index);
+  [[nodiscard]] double GetTermFreq(size_t block_index, size_t position) const;
+  // Точная частота вхождения независимо от квантования
+  [[nodiscard]] double GetExactTermFreq(size_t position) const;
+
+  template <typename Impact>
+  [[nodiscard]] const std::vector<Impact> &GetImpacts() const {
+    if constexpr (std::is_same_v<Impact, uint8_t>) {
+      return impacts8_;
+    } else {
+      return impacts16_;
+    }
+  }
+};
+
+/**
+ * Курсор для обхода списка вхождений в порядке возрастания номеров
+ * документов. Это единственный способ чтения списков вхождений: обход не
+ * копирует список и не выделяет память.
+ *
+ * Помимо текущей позиции курсор хранит «поверхностную» позицию блока
+ * (AdvanceShallowTo), по которой можно узнать верхнюю границу частоты терма
+ * для документов впереди курсора, не декодируя блок.
+ *
+ * Курсор действителен, пока список вхождений не изменяется.
+ */
+class PostingCursor {
+public:
+  // Номер документа исчерпанного курсора
+  static const int END = std::numeric_limits<int>::max();
+
+  // Пустой курсор, сразу находящийся в состоянии END
+  PostingCursor() = default;
+
+  explicit PostingCursor(const PostingList &postings);
+
+  [[nodiscard]] int GetOrdinal() const {
+    return ordinal_;
+  }
+
+  // Частота терма в текущем документе, квантованная, если у списка
+  // включено квантование
+  [[nodiscard]] double GetTermFreq() const {
+    return postings_->GetTermFreq(block_, position_);
+  }
+
+  // Оценка стоимости обхода: число оставшихся вхождений, включая текущее,
+  // вместе с неиспользуемыми местами после удалений
+  [[nodiscard]] size_t GetCost() const {
+    return postings_ == nullptr ? 0
+      : postings_->GetStorageSize() - position_;
+  }
+
+  // Проверяет, есть ли в списке документ ordinal, сдвигая курсор к нему.
+  // Номера при повторных вызовах не должны убывать
+  bool Contains(int ordinal) {
+    AdvanceTo(ordinal);
+    return ordinal_ == ordinal;
+  }
+
+  // Переход к следующему вхождению
+  void Next();
+
+  // Переход к первому вхождению с номером не меньше ordinal
+  void AdvanceTo(int ordinal);
+
+  // Переход к блоку, который может содержать ordinal, без смены текущей
+  // позиции курсора
+  void AdvanceShallowTo(int ordinal);
+
+  // Верхняя граница частоты терма для документа ordinal, переданного
+  // в последний вызов AdvanceShallowTo
+  [[nodiscard]] double GetBlockMaxTermFreq(int ordinal) const;
+
+  // Наименьший номер больше ordinal, для которого граница
+  // GetBlockMaxTermFreq может отличаться
+  [[nodiscard]] int GetBlockBoundary(int ordinal) const;
+
+private:
+  const PostingList *postings_ = nullptr;
+  size_t block_ = 0;
+  size_t shallow_block_ = 0;
+  size_t position_ = 0;
+  const uint8_t *data_ = nullptr;
+  int ordinal_ = END;
+
+  void EnterBlock(size_t block_index);
+};
+
+inline uint32_t PostingList::ReadVarint(const uint8_t *&data) {
+  uint32_t value = 0;
+  int shift = 0;
+
+  while (*data & 0x80u) {
+    value |= static_cast<uint32_t>(*data++ & 0x7Fu) << shift;
+    shift += 7;
+  }
+  value |= static_cast<uint32_t>(*data++) << shift;
+
+  return value;
+}
+
+inline double PostingList::GetTermFreq(size_t block_index,
+  size_t position) const {
+  switch (quantization_) {
+    case ImpactQuantization::BITS_8:
+      return impacts8_[position] * blocks_[block_index].impact_step;
+    case ImpactQuantization::BITS_16:
+      return impacts16_[position] * blocks_[block_index].impact_step;
+    default:
+      return GetExactTermFreq(position);
+  }
+}
+
+inline double PostingList::GetExactTermFreq(size_t position) const {
+  if (storage_ == TermFreqStorage::COUNTS) {
+    return static_cast<double>(counts_[position]) / word_counts_[position];
+  }
+  return term_freqs_[position];
+}
+
+template <typename Impact, typename Function>
+bool PostingList::ForEachImpactBlock(int begin, int end, Function func) const {
+  const std::vector<Impact> &impacts = GetImpacts<Impact>();
+  std::array<int, BLOCK_SIZE> ordinals;
+
+  for (size_t block_index = LowerBoundBlock(0, begin);
+    block_index < blocks_.size()
+    && blocks_[block_index].first_ordinal < end; ++block_index) {
+    const Block &block = blocks_[block_index];
+    const size_t count = DecodeBlock(block_index, ordinals.data());
+
+    // Границы ищутся только в крайних блоках диапазона
+    const size_t first = block.first_ordinal >= begin ? 0
+      : std::lower_bound(ordinals.begin(), ordinals.begin() + count, begin)
+        - ordinals.begin();
+    const size_t last = block.last_ordinal < end ? count
+      : std::lower_bound(ordinals.begin() + first, ordinals.begin() + count,
+        end) - ordinals.begin();
+    if (!func(ordinals.data() + first, impacts.data() + block.begin + first,
+      last - first, block.impact_step)) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -1,16 +1,73 @@
 #pragma once
 
 #include "document.h"
+#include "query_limits.h"
 #include "search_server.h"
 
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <future>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Число запросов, одновременно вычисляемых ProcessQueriesJoined
+const size_t PROCESS_QUERIES_WINDOW = 1024;
+
 std::vector<std::vector<Document>> ProcessQueries(
   const SearchServer &search_server,
   const std::vector<std::string> &queries);
 
+// Все запросы пакета укладываются в общий срок limits.deadline: запросы,
+// не успевшие оцениться, возвращаются с признаком truncated
+std::vector<SearchResult> ProcessQueries(const SearchServer &search_server,
+  const std::vector<std::string> &queries, const QueryLimits &limits);
+
+/**
+ * Вызывает sink(document) для найденных документов всех запросов по порядку
+ * запросов, не собирая общий результат.
+ *
+ * Запросы вычисляются окнами по window штук. Пока sink получает результаты
+ * одного окна, следующее уже вычисляется; следующее за ним не начнётся,
+ * пока sink не обработает текущее. Поэтому в памяти одновременно не более
+ * двух окон результатов, независимо от числа запросов.
+ */
+template <typename Sink>
+void ProcessQueriesJoined(const SearchServer &search_server,
+  const std::vector<std::string> &queries, Sink sink,
+  size_t window = PROCESS_QUERIES_WINDOW) {
+  window = std::max<size_t>(window, 1);
+
+  const auto process_window = [&search_server, &queries, window](
+    size_t begin) {
+    const size_t end = std::min(begin + window, queries.size());
+    const std::vector<std::string_view> window_queries(
+      queries.begin() + begin, queries.begin() + end);
+    return search_server.FindTopDocumentsBatch(std::execution::par,
+      window_queries);
+  };
+
+  if (queries.empty()) {
+    return;
+  }
+
+  std::future<std::vector<std::vector<Document>>> next =
+    std::async(std::launch::async, process_window, 0);
+  for (size_t begin = 0; begin < queries.size(); begin += window) {
+    const std::vector<std::vector<Document>> results = next.get();
+    if (begin + window < queries.size()) {
+      next = std::async(std::launch::async, process_window, begin + window);
+    }
+
+    for (const std::vector<Document> &documents : results) {
+      for (const Document &document : documents) {
+        sink(document);
+      }
+    }
+  }
+}
+
 std::vector<Document> ProcessQueriesJoined(
   const SearchServer& search_server,
   const std::vector<std::string>& queries);
@@ -0,0 +1,223 @@
+#include "profiler.h"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Значения меньше EXACT_BUCKET_COUNT хранятся точно, остальные - по
+// порядку (номеру старшего бита) и трём следующим битам
+const int EXACT_BUCKET_COUNT = 16;
+const int SUB_BUCKET_BITS = 3;
+const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+const int BUCKET_COUNT = EXACT_BUCKET_COUNT + (64 - 4) * SUB_BUCKET_COUNT;
+
+int GetBucket(uint64_t value) {
+  if (value < EXACT_BUCKET_COUNT) {
+    return static_cast<int>(value);
+  }
+  const int exponent = 63 - __builtin_clzll(value);
+  const int sub_bucket = static_cast<int>(
+    (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1));
+  return EXACT_BUCKET_COUNT + (exponent - 4) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+// Нижняя граница значений корзины
+uint64_t GetBucketValue(int bucket) {
+  if (bucket < EXACT_BUCKET_COUNT) {
+    return bucket;
+  }
+  const int exponent = (bucket - EXACT_BUCKET_COUNT) / SUB_BUCKET_COUNT + 4;
+  const uint64_t sub_bucket = (bucket - EXACT_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+  return (SUB_BUCKET_COUNT + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+// Счётчики пишет только поток-владелец, поэтому вместо атомарного
+// сложения достаточно чтения и записи; атомарность нужна для DumpProfile
+void Increase(std::atomic<uint64_t> &counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+    std::memory_order_relaxed);
+}
+
+struct ProfileNode {
+  ProfileNode(const char *name, int parent)
+    : name(name)
+    , parent(parent) {
+  }
+
+  const char *name;
+  int parent;
+  // Дочерние области; используются только потоком-владельцем
+  std::vector<int> children;
+
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> max{0};
+  std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+};
+
+struct ThreadProfile {
+  // Защищает добавление узлов от одновременного обхода в DumpProfile.
+  // Ссылки на элементы std::deque при добавлении в конец не меняются
+  std::mutex mutex;
+  std::deque<ProfileNode> nodes;
+  int current = 0;
+
+  ThreadProfile() {
+    nodes.emplace_back(nullptr, -1);
+  }
+
+  int GetChild(const char *name) {
+    for (const int child : nodes[current].children) {
+      // Одинаковые литералы из разных единиц трансляции могут иметь
+      // разные адреса
+      if (nodes[child].name == name
+        || std::strcmp(nodes[child].name, name) == 0) {
+        return child;
+      }
+    }
+
+    const int child = static_cast<int>(nodes.size());
+    {
+      std::lock_guard guard(mutex);
+      nodes.emplace_back(name, current);
+    }
+    nodes[current].children.push_back(child);
+    return child;
+  }
+};
+
+struct ProfileRegistry {
+  std::mutex mutex;
+  // Замеры завершившихся потоков сохраняются до конца программы
+  std::vector<std::shared_ptr<ThreadProfile>> profiles;
+};
+
+ProfileRegistry &GetRegistry() {
+  static ProfileRegistry registry;
+  return registry;
+}
+
+ThreadProfile &GetThreadProfile() {
+  thread_local const std::shared_ptr<ThreadProfile> profile = [] {
+    auto result = std::make_shared<ThreadProfile>();
+    ProfileRegistry &registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    registry.profiles.push_back(result);
+    return result;
+  }();
+  return *profile;
+}
+
+struct ProfileSummary {
+  uint64_t count = 0;
+  uint64_t total = 0;
+  uint64_t max = 0;
+  std::array<uint64_t, BUCKET_COUNT> buckets{};
+};
+
+uint64_t GetPercentile(const ProfileSummary &summary, double percentile) {
+  const auto rank = static_cast<uint64_t>(summary.count * percentile);
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+    seen += summary.buckets[bucket];
+    if (seen > rank) {
+      return GetBucketValue(bucket);
+    }
+  }
+  return summary.max;
+}
+
+}  // namespace
+
+ProfileScope::ProfileScope(const char *name) {
+  ThreadProfile &profile = GetThreadProfile();
+  parent_ = profile.current;
+  node_ = profile.GetChild(name);
+  profile.current = node_;
+  start_time_ = Clock::now();
+}
+
+ProfileScope::~ProfileScope() {
+  const auto duration = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start_time_).count());
+
+  ThreadProfile &profile = GetThreadProfile();
+  ProfileNode &node = profile.nodes[node_];
+  Increase(node.count, 1);
+  Increase(node.total, duration);
+  Increase(node.buckets[GetBucket(duration)], 1);
+  if (duration > node.max.load(std::memory_order_relaxed)) {
+    node.max.store(duration, std::memory_order_relaxed);
+  }
+  profile.current = parent_;
+}
+
+void DumpProfile(std::ostream &out) {
+  std::map<std::string, ProfileSummary> summaries;
+
+  ProfileRegistry &registry = GetRegistry();
+  std::lock_guard registry_guard(registry.mutex);
+  for (const auto &profile : registry.profiles) {
+    std::lock_guard guard(profile->mutex);
+    for (const ProfileNode &node : profile->nodes) {
+      if (node.parent < 0) {
+        continue;
+      }
+
+      std::string path = node.name;
+      for (int parent = node.parent; profile->nodes[parent].parent >= 0;
+        parent = profile->nodes[parent].parent) {
+        path = std::string(profile->nodes[parent].name) + '/' + path;
+      }
+
+      ProfileSummary &summary = summaries[path];
+      summary.count += node.count.load(std::memory_order_relaxed);
+      summary.total += node.total.load(std::memory_order_relaxed);
+      summary.max = std::max(summary.max,
+        node.max.load(std::memory_order_relaxed));
+      for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        summary.buckets[bucket] +=
+          node.buckets[bucket].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  out << "path,count,total_ns,p50_ns,p99_ns,max_ns" << std::endl;
+  for (const auto &[path, summary] : summaries) {
+    if (summary.count == 0) {
+      continue;
+    }
+    out << path << ','
+      << summary.count << ','
+      << summary.total << ','
+      << GetPercentile(summary, 0.5) << ','
+      << GetPercentile(summary, 0.99) << ','
+      << summary.max
+      << std::endl;
+  }
+}
+
+void ResetProfile() {
+  ProfileRegistry &registry = GetRegistry();
+  std::lock_guard registry_guard(registry.mutex);
+  for (const auto &profile : registry.profiles) {
+    std::lock_guard guard(profile->mutex);
+    for (ProfileNode &node : profile->nodes) {
+      node.count.store(0, std::memory_order_relaxed);
+      node.total.store(0, std::memory_order_relaxed);
+      node.max.store(0, std::memory_order_relaxed);
+      for (auto &bucket : node.buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
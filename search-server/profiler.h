@@ -0,0 +1,68 @@
+#pragma once
+
+#include "log_duration.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Иерархический профилировщик. В отличие от LOG_DURATION, замер ничего не
+ * выводит: время в наносекундах попадает в гистограмму потока, из которой
+ * по запросу (DumpProfile) собираются число вызовов, суммарное время,
+ * медиана, 99-й перцентиль и максимум.
+ *
+ * Области вкладываются: имя замера - путь из имён охватывающих областей
+ * того же потока, например "FindTopDocuments/score". Код, выполняемый
+ * параллельными алгоритмами в других потоках, попадает в корень дерева
+ * своего потока.
+ *
+ * Замеры включаются макросом SEARCH_SERVER_PROFILE при сборке. Без него
+ * PROFILE_SCOPE не порождает никакого кода.
+ *
+ * Пример использования:
+ *
+ *  void Task() {
+ *      PROFILE_SCOPE("Task");
+ *      {
+ *          PROFILE_SCOPE("step"); // Замер "Task/step"
+ *          ...
+ *      }
+ *  }
+ *
+ *  int main() {
+ *      Task();
+ *      DumpProfile(std::cerr);
+ *  }
+ */
+#ifdef SEARCH_SERVER_PROFILE
+#define PROFILE_SCOPE(x) ProfileScope UNIQUE_VAR_NAME_PROFILE(x)
+#else
+#define PROFILE_SCOPE(x)
+#endif
+
+class ProfileScope {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Имя должно жить до конца программы (строковый литерал)
+  explicit ProfileScope(const char *name);
+
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  int parent_;
+  int node_;
+  Clock::time_point start_time_;
+};
+
+// Выводит накопленные всеми потоками замеры в формате CSV, одна строка
+// на путь: path,count,total_ns,p50_ns,p99_ns,max_ns. Перцентили
+// округляются вниз с точностью около 12%
+void DumpProfile(std::ostream &out);
+
+// Обнуляет накопленные замеры; дерево имён сохраняется
+void ResetProfile();
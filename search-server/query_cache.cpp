@@ -0,0 +1,120 @@
+#include "query_cache.h"
+
+#include <algorithm>
+
+namespace {
+
+const size_t MAX_SHARD_COUNT = 16;
+
+size_t GetShardCount(size_t capacity) {
+  return std::clamp<size_t>(capacity, 1, MAX_SHARD_COUNT);
+}
+
+void HashCombine(size_t &seed, size_t value) {
+  seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+}  // namespace
+
+QueryCache::QueryCache(size_t capacity)
+  : capacity_(capacity)
+  , shards_(GetShardCount(capacity)) {
+}
+
+QueryCache::QueryCache(const QueryCache &other)
+  : QueryCache(other.capacity_) {
+}
+
+QueryCache &QueryCache::operator=(const QueryCache &other) {
+  if (this != &other) {
+    capacity_ = other.capacity_;
+    shards_ = std::vector<Shard>(other.shards_.size());
+    size_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+  }
+  return *this;
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const Key &key,
+  uint64_t generation) {
+  Shard &shard = GetShard(key);
+  {
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      Entry &entry = shard.entries[it->second];
+      if (entry.generation == generation) {
+        entry.is_referenced = true;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return entry.documents;
+      }
+    }
+  }
+
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return std::nullopt;
+}
+
+void QueryCache::Insert(Key key, uint64_t generation,
+  std::vector<Document> documents) {
+  Shard &shard = GetShard(key);
+  std::lock_guard guard(shard.mutex);
+
+  // Запись устаревшего поколения или вычисленная параллельно другим потоком
+  const auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    Entry &entry = shard.entries[it->second];
+    entry.generation = generation;
+    entry.documents = std::move(documents);
+    entry.is_referenced = true;
+    return;
+  }
+
+  size_t slot = shard.entries.size();
+  if (size_.fetch_add(1, std::memory_order_relaxed) < capacity_
+    || shard.entries.empty()) {
+    shard.entries.emplace_back();
+  } else {
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    // Запись, к которой обращались с прошлого прохода стрелки, получает
+    // ещё один шанс
+    while (shard.entries[shard.hand].is_referenced) {
+      shard.entries[shard.hand].is_referenced = false;
+      shard.hand = (shard.hand + 1) % shard.entries.size();
+    }
+    slot = shard.hand;
+    shard.hand = (shard.hand + 1) % shard.entries.size();
+    shard.index.erase(*shard.entries[slot].key);
+  }
+
+  const auto [inserted, _] = shard.index.emplace(std::move(key), slot);
+  Entry &entry = shard.entries[slot];
+  entry.key = &inserted->first;
+  entry.generation = generation;
+  entry.documents = std::move(documents);
+  entry.is_referenced = false;
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+  return {
+    hits_.load(std::memory_order_relaxed),
+    misses_.load(std::memory_order_relaxed)
+  };
+}
+
+size_t QueryCache::KeyHash::operator()(const Key &key) const {
+  size_t seed = static_cast<size_t>(key.status);
+  for (const TermId term_id : key.plus_terms) {
+    HashCombine(seed, term_id);
+  }
+  HashCombine(seed, key.plus_terms.size());
+  for (const TermId term_id : key.minus_terms) {
+    HashCombine(seed, term_id);
+  }
+  return seed;
+}
+
+QueryCache::Shard &QueryCache::GetShard(const Key &key) {
+  return shards_[KeyHash()(key) % shards_.size()];
+}
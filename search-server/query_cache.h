@@ -0,0 +1,102 @@
+#pragma once
+
+#include "document.h"
+#include "term_dictionary.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Ограниченный кеш результатов FindTopDocuments. Ключ - разобранный запрос
+ * (отсортированные идентификаторы плюс- и минус-слов без стоп-слов) и
+ * требуемый статус документов, поэтому запросы, отличающиеся порядком
+ * слов, повторами и стоп-словами, разделяют одну запись.
+ *
+ * Каждая запись помнит поколение индекса, для которого она вычислена;
+ * запись другого поколения считается промахом. Кеш разбит на сегменты со
+ * своими мьютексами и допускает одновременные обращения из разных потоков.
+ * Ёмкость общая для всех сегментов: пока записей меньше capacity, новые
+ * записи только добавляются, поэтому кеш вмещает capacity разных запросов
+ * независимо от их распределения по сегментам. Затем новая запись
+ * вытесняет запись своего сегмента по алгоритму CLOCK; в пустом сегменте
+ * она добавляется сверх ёмкости, поэтому записей может быть на число
+ * сегментов больше capacity.
+ *
+ * Копия кеша пуста и имеет ту же ёмкость: результаты привязаны к поколениям
+ * индекса, из которого они получены.
+ */
+class QueryCache {
+public:
+  struct Key {
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    DocumentStatus status;
+
+    bool operator==(const Key &other) const {
+      return status == other.status && plus_terms == other.plus_terms
+        && minus_terms == other.minus_terms;
+    }
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  // Нулевая ёмкость отключает кеш
+  explicit QueryCache(size_t capacity = 0);
+
+  QueryCache(const QueryCache &other);
+  QueryCache &operator=(const QueryCache &other);
+
+  [[nodiscard]] bool IsEnabled() const {
+    return capacity_ > 0;
+  }
+
+  [[nodiscard]] size_t GetCapacity() const {
+    return capacity_;
+  }
+
+  // Результат для ключа, вычисленный в поколении generation
+  std::optional<std::vector<Document>> Find(const Key &key,
+    uint64_t generation);
+
+  void Insert(Key key, uint64_t generation, std::vector<Document> documents);
+
+  [[nodiscard]] Stats GetStats() const;
+
+private:
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct Entry {
+    // Ключ хранится в index сегмента; ссылки на элементы unordered_map
+    // не меняются при перехешировании
+    const Key *key = nullptr;
+    uint64_t generation = 0;
+    std::vector<Document> documents;
+    bool is_referenced = false;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, size_t, KeyHash> index;
+    std::vector<Entry> entries;
+    size_t hand = 0;
+  };
+
+  size_t capacity_;
+  std::vector<Shard> shards_;
+  // Число записей во всех сегментах
+  std::atomic<size_t> size_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+
+  Shard &GetShard(const Key &key);
+};
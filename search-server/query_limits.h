@@ -0,0 +1,65 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * Признак отмены запроса. Копии токена разделяют один признак: вызывающий
+ * оставляет копию у себя и вызывает Cancel из любого потока, пока запрос
+ * выполняется.
+ */
+class CancellationToken {
+public:
+  CancellationToken()
+    : is_cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+  }
+
+  void Cancel() const {
+    is_cancelled_->store(true, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool IsCancelled() const {
+    return is_cancelled_->load(std::memory_order_relaxed);
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+/**
+ * Ограничения времени выполнения запроса. Поиск проверяет их между блоками
+ * списков вхождений (PostingList::BLOCK_SIZE документов), поэтому запрос
+ * завершается не позже чем через оценку одного блока после срока или отмены.
+ */
+struct QueryLimits {
+  using Clock = std::chrono::steady_clock;
+
+  // Без ограничения по умолчанию
+  Clock::time_point deadline = Clock::time_point::max();
+  CancellationToken cancellation;
+  // При превышении: true - вернуть лучшие документы среди уже оценённых,
+  // false - прервать запрос с пустым результатом
+  bool return_partial = true;
+
+  [[nodiscard]] static QueryLimits WithTimeout(Clock::duration timeout) {
+    QueryLimits limits;
+    limits.deadline = Clock::now() + timeout;
+    return limits;
+  }
+
+  [[nodiscard]] bool IsExceeded() const {
+    return cancellation.IsCancelled() || Clock::now() >= deadline;
+  }
+};
+
+// Результат поиска с ограничениями
+struct SearchResult {
+  std::vector<Document> documents;
+  // Оценка прервана по сроку или отмене. Релевантность возвращённых
+  // документов точная, но оценены не все документы
+  bool truncated = false;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "posting_list.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Плотный накопитель релевантности для непрерывного диапазона порядковых
+ * номеров документов. Документ адресуется смещением от начала диапазона,
+ * поэтому сложение вклада слова — это запись в массив без блокировок и
+ * поиска по дереву.
+ *
+ * Накопитель рассчитан на повторное использование: Drain возвращает его
+ * в пустое состояние, очищая только затронутые ячейки.
+ */
+class RelevanceAccumulator {
+public:
+  // Наибольшее число вхождений в одном вызове AddImpacts
+  static const size_t MAX_IMPACT_BLOCK_SIZE = PostingList::BLOCK_SIZE;
+
+  // Подготавливает накопитель к диапазону из size документов
+  void Reset(int size) {
+    if (static_cast<int>(relevance_.size()) < size) {
+      relevance_.resize(size, 0.0);
+      states_.resize(size, NONE);
+    }
+    size_ = size;
+  }
+
+  void Add(int offset, double relevance) {
+    if (states_[offset] == NONE) {
+      states_[offset] = MATCHED;
+      touched_.push_back(offset);
+    }
+    relevance_[offset] += relevance;
+  }
+
+  // Добавляет вклады части блока вхождений: документ ordinals[i] - base
+  // получает impacts[i] * step * inverse_document_freq. Если задана
+  // битовая карта status_bitmap, документы без бита в ней пропускаются.
+  // Вклады и номера отобранных вхождений вычисляются проходами по
+  // непрерывным массивам без ветвлений, которые компилятор векторизует;
+  // в накопитель записываются только отобранные вхождения
+  template <typename Impact>
+  void AddImpacts(const int *ordinals, int base, const Impact *impacts,
+    size_t count, double step, double inverse_document_freq,
+    const uint64_t *status_bitmap = nullptr) {
+    const double scale = step * inverse_document_freq;
+    std::array<double, MAX_IMPACT_BLOCK_SIZE> contributions;
+    for (size_t i = 0; i < count; ++i) {
+      contributions[i] = impacts[i] * scale;
+    }
+
+    std::array<uint8_t, MAX_IMPACT_BLOCK_SIZE> selected;
+    size_t selected_count = count;
+    if (status_bitmap != nullptr) {
+      selected_count = 0;
+      for (size_t i = 0; i < count; ++i) {
+        const int ordinal = ordinals[i];
+        selected[selected_count] = static_cast<uint8_t>(i);
+        selected_count += (status_bitmap[ordinal >> 6] >> (ordinal & 63)) & 1;
+      }
+    }
+
+    for (size_t j = 0; j < selected_count; ++j) {
+      const size_t i = status_bitmap != nullptr ? selected[j] : j;
+      const int offset = ordinals[i] - base;
+      relevance_[offset] += contributions[i];
+      if (states_[offset] == NONE) {
+        states_[offset] = MATCHED;
+        touched_.push_back(offset);
+      }
+    }
+  }
+
+  // Вызывает func(offset, relevance) для найденных документов по
+  // возрастанию смещения и очищает накопитель
+  template <typename Function>
+  void Drain(Function func) {
+    // При большом числе затронутых ячеек проход по массиву дешевле сортировки
+    if (touched_.size() * 16 >= static_cast<size_t>(size_)) {
+      for (int offset = 0; offset < size_; ++offset) {
+        if (states_[offset] == MATCHED) {
+          func(offset, relevance_[offset]);
+        }
+      }
+    } else {
+      std::sort(touched_.begin(), touched_.end());
+      for (const int offset : touched_) {
+        if (states_[offset] == MATCHED) {
+          func(offset, relevance_[offset]);
+        }
+      }
+    }
+
+    Clear();
+  }
+
+  // Очищает накопитель, не перечисляя документы
+  void Clear() {
+    for (const int offset : touched_) {
+      relevance_[offset] = 0.0;
+      states_[offset] = NONE;
+    }
+    touched_.clear();
+  }
+
+private:
+  enum State : uint8_t {
+    NONE,
+    MATCHED,
+  };
+
+  std::vector<double> relevance_;
+  std::vector<State> states_;
+  std::vector<int> touched_;
+  int size_ = 0;
+};
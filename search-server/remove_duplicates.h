@@ -2,4 +2,18 @@
 
 #include "search_server.h"
 
+#include <vector>
+
+// Удаляет документы, совпадающие с документом с меньшим идентификатором
+// (см. SearchServer::FindDuplicates), и возвращает их идентификаторы
+template <typename ExecutionPolicy>
+std::vector<int> RemoveDuplicates(ExecutionPolicy &&policy,
+  SearchServer &search_server, double similarity_threshold = 1.0) {
+  std::vector<int> duplicates = search_server.FindDuplicates(policy,
+    similarity_threshold);
+  search_server.RemoveDocuments(policy, duplicates);
+  return duplicates;
+}
+
+// Удаляет точные дубликаты и сообщает о каждом в std::cout
 void RemoveDuplicates(SearchServer& search_server);
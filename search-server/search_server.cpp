@@ -1,61 +1,311 @@
 #include "search_server.h"
 
 #include <execution>
+#include <limits>
+#include <thread>
 
 using std::string_literals::operator""s;
 
-const std::map<std::string_view, double>
-&SearchServer::GetWordFrequencies(int document_id) const {
-  static std::map<std::string_view, double> result;
+namespace {
+  const int MIN_SCORING_CHUNK_SIZE = 1 << 12;
+  const int MAX_SCORING_CHUNK_SIZE = 1 << 16;
+  // Цвет и указатели узла красно-чёрного дерева std::map и std::set
+  const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+
+  // Вызывает func(term_id) для каждого терма terms (по возрастанию), который
+  // есть среди term_counts. Позиция в term_counts ищется экспоненциальным
+  // поиском от предыдущей, поэтому редкие совпадения не требуют
+  // просмотра всех термов документа
+  template <typename Function>
+  void ForEachCommonTerm(const std::vector<TermId> &terms,
+    const std::vector<TermCount> &term_counts, Function func) {
+    const auto is_less = [](const TermCount &term_count, TermId term_id) {
+      return term_count.term_id < term_id;
+    };
+
+    auto first = term_counts.begin();
+    const auto last = term_counts.end();
+    for (const TermId term_id : terms) {
+      // Всё до first меньше term_id; bound - конец или не меньший элемент
+      auto bound = first;
+      for (ptrdiff_t step = 1; bound != last && bound->term_id < term_id;
+        step *= 2) {
+        first = bound + 1;
+        bound = step < last - bound ? bound + step : last;
+      }
 
-  if (document_to_word_freqs_.count(document_id) != 0) {
-    for (const auto &[key, val] : document_to_word_freqs_.at(document_id)) {
-      result[key] = val;
+      first = std::lower_bound(first, bound, term_id, is_less);
+      if (first == last) {
+        return;
+      }
+      if (first->term_id == term_id) {
+        func(term_id);
+        ++first;
+      }
     }
   }
 
-  return result;
+  // Финальное перемешивание splitmix64
+  uint64_t MixHash(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+  }
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+  const auto it = document_ordinals_.find(document_id);
+  if (it == document_ordinals_.end()) {
+    return WordFrequencies();
+  }
+
+  const DocumentData &document = documents_[it->second];
+  return WordFrequencies(dictionary_, document.term_counts.data(),
+    document.term_counts.data() + document.term_counts.size(),
+    document.word_count);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
   return RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::RemoveDocuments(const std::vector<int> &document_ids) {
+  RemoveDocuments(std::execution::seq, document_ids);
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document,
   DocumentStatus status, const std::vector<int> &ratings) {
+  PROFILE_SCOPE("AddDocument");
 
   // Попытка добавить документ с отрицательным id или с id ранее добавленного
   // документа
-  if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+  if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
     throw std::invalid_argument("Invalid document id"s);
   }
 
-  documents_.emplace(document_id,
-    DocumentData{
-      ComputeAverageRating(ratings),
-      status,
-      std::string(document) // Оригинал строки
-    });
+  std::vector<TermId> term_ids;
+  {
+    PROFILE_SCOPE("parse");
 
-  auto &src_string = documents_.find(document_id)->second.data;
-  const std::vector<std::string_view> words = SplitIntoWordsNoStop(src_string);
-  const double inv_word_count = 1.0 / words.size();
+    // Разбор и проверка текста до изменения индекса
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    if (term_freq_storage_ == TermFreqStorage::COUNTS
+      && words.size() > MAX_COUNTED_WORD_COUNT) {
+      throw std::invalid_argument("Document is too long"s);
+    }
 
-  for (const std::string_view word : words) {
-    word_to_document_freqs_[word][document_id] += inv_word_count;
-    document_to_word_freqs_[document_id][word] += inv_word_count;
+    term_ids.reserve(words.size());
+    for (const std::string_view word : words) {
+      term_ids.push_back(dictionary_.Intern(word));
+    }
+    ResizePostings();
+  }
+
+  const auto word_count = static_cast<uint32_t>(term_ids.size());
+  std::vector<TermCount> term_counts = ComputeTermCounts(std::move(term_ids));
+
+  ++generation_;
+  const int ordinal = static_cast<int>(documents_.size());
+  {
+    PROFILE_SCOPE("index");
+    for (const auto &[term_id, count] : term_counts) {
+      postings_[term_id].PushBack(ordinal, count, word_count);
+    }
   }
 
+  documents_.push_back({
+    texts_.Add(document),
+    word_count,
+    std::move(term_counts)
+  });
+  attributes_.Add(document_id, ComputeAverageRating(ratings), status);
+
+  document_ordinals_.emplace(document_id, ordinal);
   documents_ids_.insert(document_id);
+  UpdateLogDocumentCount();
+}
+
+void SearchServer::AddDocuments(const std::vector<DocumentInput> &documents) {
+  AddDocuments(std::execution::seq, documents);
+}
+
+void SearchServer::Compact() {
+  Compact(std::execution::seq);
+}
+
+void SearchServer::SaveSnapshot(const std::string &path) const {
+  SnapshotWriter writer(path);
+
+  dictionary_.Save(writer);
+  writer.Write<uint64_t>(stop_word_count_);
+  writer.Write(static_cast<int32_t>(query_evaluation_));
+  writer.Write(static_cast<int32_t>(term_freq_storage_));
+  writer.Write(static_cast<int32_t>(impact_quantization_));
+
+  writer.Write<uint64_t>(postings_.size());
+  for (const PostingList &postings : postings_) {
+    postings.Save(writer);
+  }
+
+  // Документы хранятся столбцами; прямой индекс всех документов записан
+  // подряд, границы документов заданы смещениями
+  std::vector<int> ids;
+  std::vector<int> ratings;
+  std::vector<int> statuses;
+  std::vector<uint8_t> is_live;
+  std::vector<uint32_t> word_counts;
+  std::vector<uint64_t> term_offsets{0};
+  std::vector<TermId> term_ids;
+  std::vector<uint32_t> counts;
+
+  for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+    const int document_ordinal = static_cast<int>(ordinal);
+    ids.push_back(attributes_.GetId(document_ordinal));
+    ratings.push_back(attributes_.GetRating(document_ordinal));
+    statuses.push_back(
+      static_cast<int>(attributes_.GetStatus(document_ordinal)));
+    is_live.push_back(IsLive(document_ordinal));
+    word_counts.push_back(documents_[ordinal].word_count);
+    for (const auto &[term_id, count] : documents_[ordinal].term_counts) {
+      term_ids.push_back(term_id);
+      counts.push_back(count);
+    }
+    term_offsets.push_back(term_ids.size());
+  }
+
+  writer.WriteArray(ids);
+  writer.WriteArray(ratings);
+  writer.WriteArray(statuses);
+  writer.WriteArray(is_live);
+  writer.WriteArray(word_counts);
+  writer.WriteArray(term_offsets);
+  writer.WriteArray(term_ids);
+  writer.WriteArray(counts);
+  for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+    writer.WriteString(is_live[ordinal]
+      ? texts_.Get(documents_[ordinal].text) : std::string_view());
+  }
+
+  writer.Finish();
+}
+
+SearchServer SearchServer::OpenSnapshot(const std::string &path) {
+  SnapshotReader reader(path);
+  SearchServer search_server;
+
+  search_server.dictionary_ = TermDictionary::Load(reader);
+  search_server.stop_word_count_ = reader.Read<uint64_t>();
+  search_server.query_evaluation_ =
+    static_cast<QueryEvaluation>(reader.Read<int32_t>());
+  const auto term_freq_storage = reader.Read<int32_t>();
+  if (term_freq_storage != static_cast<int32_t>(TermFreqStorage::DOUBLE)
+    && term_freq_storage != static_cast<int32_t>(TermFreqStorage::COUNTS)) {
+    throw std::runtime_error("Snapshot file is corrupted"s);
+  }
+  const auto impact_quantization = reader.Read<int32_t>();
+  if (impact_quantization < static_cast<int32_t>(ImpactQuantization::EXACT)
+    || impact_quantization > static_cast<int32_t>(ImpactQuantization::BITS_8)) {
+    throw std::runtime_error("Snapshot file is corrupted"s);
+  }
+
+  const auto postings_count = reader.Read<uint64_t>();
+  if (postings_count != search_server.dictionary_.size()
+    || search_server.stop_word_count_ > postings_count) {
+    throw std::runtime_error("Snapshot file is corrupted"s);
+  }
+  search_server.postings_.reserve(postings_count);
+  for (uint64_t i = 0; i < postings_count; ++i) {
+    search_server.postings_.push_back(PostingList::Load(reader));
+    if (static_cast<int32_t>(search_server.postings_.back()
+      .GetTermFreqStorage()) != term_freq_storage) {
+      throw std::runtime_error("Snapshot file is corrupted"s);
+    }
+  }
+
+  std::vector<int> ids;
+  std::vector<int> ratings;
+  std::vector<int> statuses;
+  std::vector<uint8_t> is_live;
+  std::vector<uint32_t> word_counts;
+  std::vector<uint64_t> term_offsets;
+  std::vector<TermId> term_ids;
+  std::vector<uint32_t> counts;
+
+  reader.ReadArray(ids);
+  reader.ReadArray(ratings);
+  reader.ReadArray(statuses);
+  reader.ReadArray(is_live);
+  reader.ReadArray(word_counts);
+  reader.ReadArray(term_offsets);
+  reader.ReadArray(term_ids);
+  reader.ReadArray(counts);
+
+  const size_t document_count = ids.size();
+  if (ratings.size() != document_count || statuses.size() != document_count
+    || is_live.size() != document_count
+    || word_counts.size() != document_count
+    || term_offsets.size() != document_count + 1
+    || term_offsets.back() != term_ids.size()
+    || counts.size() != term_ids.size()) {
+    throw std::runtime_error("Snapshot file is corrupted"s);
+  }
+  for (const int status : statuses) {
+    if (status < 0 || static_cast<size_t>(status) >= DOCUMENT_STATUS_COUNT) {
+      throw std::runtime_error("Snapshot file is corrupted"s);
+    }
+  }
+  for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+    if (is_live[ordinal]
+      && term_freq_storage == static_cast<int32_t>(TermFreqStorage::COUNTS)
+      && word_counts[ordinal] > MAX_COUNTED_WORD_COUNT) {
+      throw std::runtime_error("Snapshot file is corrupted"s);
+    }
+  }
+
+  search_server.documents_.reserve(document_count);
+  search_server.attributes_.Reserve(document_count);
+  for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+    std::vector<TermCount> document_term_counts;
+    for (uint64_t i = term_offsets[ordinal]; i < term_offsets[ordinal + 1];
+      ++i) {
+      document_term_counts.push_back({term_ids[i], counts[i]});
+    }
+
+    search_server.documents_.push_back({
+      search_server.texts_.Add(reader.ReadString()),
+      word_counts[ordinal],
+      std::move(document_term_counts)
+    });
+    search_server.attributes_.Add(ids[ordinal], ratings[ordinal],
+      static_cast<DocumentStatus>(statuses[ordinal]));
+
+    if (is_live[ordinal]) {
+      search_server.document_ordinals_.emplace(ids[ordinal],
+        static_cast<int>(ordinal));
+      search_server.documents_ids_.insert(ids[ordinal]);
+    } else {
+      search_server.attributes_.Remove(static_cast<int>(ordinal));
+    }
+  }
+
+  search_server.UpdateLogDocumentCount();
+  search_server.term_freq_storage_ =
+    static_cast<TermFreqStorage>(term_freq_storage);
+  // Квантованные частоты не записываются и вычисляются по точным
+  if (impact_quantization != static_cast<int32_t>(ImpactQuantization::EXACT)) {
+    search_server.SetImpactQuantization(
+      static_cast<ImpactQuantization>(impact_quantization));
+  }
+
+  reader.Finish();
+  return search_server;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(
   const std::string_view raw_query, DocumentStatus requested_status) const {
-  return SearchServer::FindTopDocuments(raw_query,
-    [requested_status](int document_id,
-      DocumentStatus status, int rating) {
-      return requested_status == status;
-    });
+  return SearchServer::FindTopDocuments(std::execution::seq, raw_query,
+    requested_status);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(
@@ -63,8 +313,53 @@ std::vector<Document> SearchServer::FindTopDocuments(
   return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+void SearchServer::CollectCorpusStatistics(std::string_view raw_query,
+  CorpusStatistics &statistics) const {
+  const Query query = ParseQuery(raw_query);
+
+  statistics.document_count += GetDocumentCount();
+  for (const TermId term_id : query.plus_terms) {
+    if (postings_[term_id].empty()) {
+      continue;
+    }
+
+    const std::string_view word = dictionary_.GetTerm(term_id);
+    auto it = statistics.document_freqs.find(word);
+    if (it == statistics.document_freqs.end()) {
+      it = statistics.document_freqs.emplace(std::string(word), 0).first;
+    }
+    it->second += static_cast<int>(postings_[term_id].size());
+  }
+}
+
+PostingCursor SearchServer::GetPostingCursor(std::string_view word) const {
+  const TermId term_id = dictionary_.Find(word);
+  if (term_id == TermDictionary::NO_TERM) {
+    return PostingCursor();
+  }
+
+  return PostingCursor(postings_[term_id]);
+}
+
+int SearchServer::GetDocumentId(int ordinal) const {
+  if (ordinal < 0 || static_cast<size_t>(ordinal) >= attributes_.size()) {
+    throw std::out_of_range("Invalid document ordinal"s);
+  }
+  return attributes_.GetId(ordinal);
+}
+
 int SearchServer::GetDocumentCount() const {
-  return static_cast<int>(documents_.size());
+  return static_cast<int>(document_ordinals_.size());
+}
+
+SearchResult SearchServer::MakeSearchResult(std::vector<Document> documents,
+  const QueryBudget &budget) {
+  SearchResult result;
+  result.truncated = budget.WasExhausted();
+  if (!result.truncated || budget.GetLimits().return_partial) {
+    result.documents = std::move(documents);
+  }
+  return result;
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus>
@@ -76,80 +371,122 @@ std::tuple<std::vector<std::string_view>, DocumentStatus>
 SearchServer::MatchDocument(const std::execution::sequenced_policy&,
   const std::string_view raw_query, int document_id) const {
   const Query query = ParseQuery(raw_query);
-  const auto status = documents_.at(document_id).status;
+  const int ordinal = document_ordinals_.at(document_id);
+  const auto status = attributes_.GetStatus(ordinal);
 
-  for (const std::string_view word : query.minus_words) {
-    if (word_to_document_freqs_.count(word) == 0) {
-      continue;
-    }
-    if (word_to_document_freqs_.at(word).count(document_id) > 0) {
+  for (const TermId term_id : query.minus_terms) {
+    if (postings_[term_id].Contains(ordinal)) {
       return {std::vector<std::string_view>(), status};
     }
   }
 
-  std::vector<std::string_view> matched_words;
-  for (const std::string_view word : query.plus_words) {
-    if (word_to_document_freqs_.count(word) == 0) {
-      continue;
-    }
-    if (word_to_document_freqs_.at(word).count(document_id) > 0) {
-      matched_words.push_back(word);
+  std::vector<TermId> matched_terms;
+  for (const TermId term_id : query.plus_terms) {
+    if (postings_[term_id].Contains(ordinal)) {
+      matched_terms.push_back(term_id);
     }
   }
 
-  return {matched_words, status};
+  return {GetMatchedWords(std::move(matched_terms)), status};
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus>
 SearchServer::MatchDocument(const std::execution::parallel_policy&,
   std::string_view raw_query, int document_id) const {
+  return MatchDocument(ResolvePolicy(std::execution::par), raw_query,
+    document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+SearchServer::MatchDocument(const ThreadPoolPolicy &policy,
+  std::string_view raw_query, int document_id) const {
 
   const auto query = ParseQuery(raw_query, false);
-  const auto status = documents_.at(document_id).status;
-  const auto word_checker =
-    [this, document_id](std::string_view word) {
-      const auto it = word_to_document_freqs_.find(word);
-      return it != word_to_document_freqs_.end() && it->second.count(document_id);
-    };
+  const int ordinal = document_ordinals_.at(document_id);
+  const auto status = attributes_.GetStatus(ordinal);
+
+  // Слова запроса проверяются независимо: сначала минус-слова, затем
+  // плюс-слова
+  std::vector<TermId> terms = query.minus_terms;
+  terms.insert(terms.end(), query.plus_terms.begin(), query.plus_terms.end());
+  std::vector<uint8_t> is_found(terms.size(), 0);
+  std::vector<size_t> indexes(terms.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+
+  ForEach(policy, indexes.begin(), indexes.end(),
+    [this, ordinal, &terms, &is_found](size_t index) {
+      is_found[index] = postings_[terms[index]].Contains(ordinal);
+    });
 
-  if (any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), word_checker)) {
+  const auto minus_end = is_found.begin() + query.minus_terms.size();
+  if (std::find(is_found.begin(), minus_end, 1) != minus_end) {
     return {std::vector<std::string_view>(), status};
   }
 
-  std::vector<std::string_view> matched_words(query.plus_words.size());
-  auto words_end = copy_if(
-    std::execution::par,
-    query.plus_words.begin(), query.plus_words.end(),
-    matched_words.begin(),
-    word_checker
-  );
+  std::vector<TermId> matched_terms;
+  for (size_t index = query.minus_terms.size(); index < terms.size(); ++index) {
+    if (is_found[index]) {
+      matched_terms.push_back(terms[index]);
+    }
+  }
 
-  sort(matched_words.begin(), words_end);
-  words_end = unique(matched_words.begin(), words_end);
-  matched_words.erase(words_end, matched_words.end());
+  sort(matched_terms.begin(), matched_terms.end());
+  matched_terms.erase(unique(matched_terms.begin(), matched_terms.end()),
+    matched_terms.end());
 
-  return {matched_words, status};
+  return {GetMatchedWords(std::move(matched_terms)), status};
 }
 
-bool SearchServer::IsValidWord(const std::string_view word) {
-  return std::none_of(word.begin(), word.end(), [](char c) {
-    return c >= '\0' && c < ' ';
+void SearchServer::MatchDocuments(const std::string_view raw_query,
+  const std::vector<int> &document_ids,
+  std::vector<MatchResult> &results) const {
+  MatchDocuments(std::execution::seq, raw_query, document_ids, results);
+}
+
+void SearchServer::MatchOrdinal(const Query &query, int ordinal,
+  MatchResult &result) const {
+  auto &[words, status] = result;
+  words.clear();
+  status = attributes_.GetStatus(ordinal);
+
+  const std::vector<TermCount> &term_counts = documents_[ordinal].term_counts;
+  bool has_minus_word = false;
+  ForEachCommonTerm(query.minus_terms, term_counts, [&has_minus_word](TermId) {
+    has_minus_word = true;
   });
+  if (has_minus_word) {
+    return;
+  }
+
+  ForEachCommonTerm(query.plus_terms, term_counts, [this, &words](
+    TermId term_id) {
+    words.push_back(dictionary_.GetTerm(term_id));
+  });
+  std::sort(words.begin(), words.end());
+}
+
+bool SearchServer::IsValidWord(const std::string_view word) {
+  return !HasControlCharacters(word);
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-  return stop_words_.count(std::string(word)) > 0;
+  return IsStopWord(dictionary_.Find(word));
+}
+
+bool SearchServer::IsStopWord(TermId term_id) const {
+  return term_id < stop_word_count_;
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(
   const std::string_view text) const {
-  std::vector<std::string_view> words;
-
-  for (const std::string_view word : SplitIntoWords(text)) {
-    if (!IsValidWord(word)) {
-      throw std::invalid_argument("Special character detected"s);
-    }
+  TokenizedText tokens = Tokenize(text);
+  if (!tokens.is_valid) {
+    throw std::invalid_argument("Special character detected"s);
+  }
 
+  std::vector<std::string_view> words;
+  words.reserve(tokens.words.size());
+  for (const std::string_view word : tokens.words) {
     if (!IsStopWord(word)) {
       words.push_back(word);
     }
@@ -157,6 +494,133 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(
   return words;
 }
 
+void SearchServer::ValidateDocumentIds(
+  const std::vector<DocumentInput> &documents) const {
+  std::vector<int> ids;
+  ids.reserve(documents.size());
+
+  for (const DocumentInput &document : documents) {
+    if ((document.id < 0) || (document_ordinals_.count(document.id) > 0)) {
+      throw std::invalid_argument("Invalid document id"s);
+    }
+    ids.push_back(document.id);
+  }
+
+  // Повтор идентификатора внутри пакета
+  std::sort(ids.begin(), ids.end());
+  if (std::adjacent_find(ids.begin(), ids.end()) != ids.end()) {
+    throw std::invalid_argument("Invalid document id"s);
+  }
+}
+
+std::vector<TermCount> SearchServer::ComputeTermCounts(
+  std::vector<TermId> term_ids) {
+  std::sort(term_ids.begin(), term_ids.end());
+
+  std::vector<TermCount> term_counts;
+  for (const TermId term_id : term_ids) {
+    if (term_counts.empty() || term_counts.back().term_id != term_id) {
+      term_counts.push_back({term_id, 0});
+    }
+    ++term_counts.back().count;
+  }
+
+  return term_counts;
+}
+
+uint64_t SearchServer::HashTerms(
+  const std::vector<TermCount> &term_counts, uint64_t seed) {
+  uint64_t hash = MixHash(seed + term_counts.size());
+  for (const auto &[term_id, count] : term_counts) {
+    hash = MixHash(hash ^ term_id);
+  }
+  return hash;
+}
+
+std::array<uint64_t, MINHASH_BAND_COUNT * MINHASH_ROW_COUNT>
+SearchServer::ComputeMinHash(const std::vector<TermCount> &term_counts) {
+  std::array<uint64_t, MINHASH_BAND_COUNT * MINHASH_ROW_COUNT> signature;
+  signature.fill(std::numeric_limits<uint64_t>::max());
+
+  for (const auto &[term_id, count] : term_counts) {
+    // Значения хеш-функций для терма получаются из одного хеша
+    uint64_t hash = MixHash(term_id);
+    for (uint64_t &value : signature) {
+      hash = MixHash(hash);
+      value = std::min(value, hash);
+    }
+  }
+  return signature;
+}
+
+double SearchServer::ComputeJaccardSimilarity(
+  const std::vector<TermCount> &lhs,
+  const std::vector<TermCount> &rhs) {
+  if (lhs.empty() && rhs.empty()) {
+    return 1.0;
+  }
+
+  size_t intersection = 0;
+  auto lhs_it = lhs.begin();
+  auto rhs_it = rhs.begin();
+  while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+    if (lhs_it->term_id < rhs_it->term_id) {
+      ++lhs_it;
+    } else if (rhs_it->term_id < lhs_it->term_id) {
+      ++rhs_it;
+    } else {
+      ++intersection;
+      ++lhs_it;
+      ++rhs_it;
+    }
+  }
+
+  return static_cast<double>(intersection)
+    / (lhs.size() + rhs.size() - intersection);
+}
+
+bool SearchServer::HasSameTerms(const std::vector<TermCount> &lhs,
+  const std::vector<TermCount> &rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+    [](const TermCount &lhs, const TermCount &rhs) {
+      return lhs.term_id == rhs.term_id;
+    });
+}
+
+SearchServer::MinusDocuments SearchServer::CollectMinusDocuments(
+  const Query &query) const {
+  PROFILE_SCOPE("minus-filter");
+
+  MinusDocuments minus_documents;
+  if (query.minus_terms.empty()) {
+    return minus_documents;
+  }
+
+  std::vector<int> ordinals;
+  for (const TermId term_id : query.minus_terms) {
+    const PostingList &postings = postings_[term_id];
+    if (const DocumentBitmap *bitmap = postings.GetDocumentBitmap()) {
+      minus_documents.bitmaps.push_back(bitmap);
+      continue;
+    }
+    PostingCursor cursor(postings);
+    for (; cursor.GetOrdinal() != PostingCursor::END; cursor.Next()) {
+      ordinals.push_back(cursor.GetOrdinal());
+    }
+  }
+
+  // Карта заполняется по возрастанию номеров, без вставок в середину
+  std::sort(ordinals.begin(), ordinals.end());
+  for (const int ordinal : ordinals) {
+    minus_documents.collected.Add(ordinal);
+  }
+  return minus_documents;
+}
+
+bool SearchServer::IsLive(int ordinal) const {
+  return attributes_.IsLive(ordinal);
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
   if (ratings.empty()) {
     return 0;
@@ -167,7 +631,8 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
   return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text,
+  bool check_characters) const {
   bool is_minus = false;
 
   if (text.empty()) {
@@ -193,16 +658,16 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
   }
 
   // Проверка на запрещённые символы
-  if (!IsValidWord(text)) {
+  if (check_characters && !IsValidWord(text)) {
     throw std::invalid_argument("Special character detected"s);
   }
 
-  bool is_stop_word = IsStopWord(text);
+  const TermId term_id = dictionary_.Find(text);
 
   return {
-    text,
+    term_id,
     is_minus,
-    is_stop_word
+    IsStopWord(term_id)
   };
 }
 
@@ -210,21 +675,25 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text,
   bool make_uniq) const {
   Query query;
 
-  for (const std::string_view word : SplitIntoWords(text)) {
-    const auto query_word = ParseQueryWord(word);
+  // Слова проверяются по отдельности, только если в запросе есть
+  // запрещённые символы: так сохраняется порядок сообщений об ошибках
+  const TokenizedText tokens = Tokenize(text);
+  for (const std::string_view word : tokens.words) {
+    const auto query_word = ParseQueryWord(word, !tokens.is_valid);
 
-    if (!query_word.is_stop) {
+    // Слова, которых нет в словаре, не встречаются ни в одном документе
+    if (!query_word.is_stop && query_word.term_id != TermDictionary::NO_TERM) {
       if (query_word.is_minus) {
-        query.minus_words.push_back(query_word.data);
+        query.minus_terms.push_back(query_word.term_id);
       } else {
-        query.plus_words.push_back(query_word.data);
+        query.plus_terms.push_back(query_word.term_id);
       }
     }
   }
 
   if (make_uniq) {
     // Удаление дубликатов из векторов "плюс" и "минус" слов
-    for (auto *word : {&query.plus_words, &query.minus_words}) {
+    for (auto *word : {&query.plus_terms, &query.minus_terms}) {
       std::sort(word->begin(), word->end());
       auto trash_pos = std::unique(word->begin(), word->end());
       word->erase(trash_pos, word->end());
@@ -234,8 +703,148 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text,
   return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(
-  const std::string_view word) const {
-  const auto size = word_to_document_freqs_.at(word).size();
-  return std::log(GetDocumentCount() * 1.0 / size);
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id,
+  const CorpusStatistics *statistics) const {
+  // Логарифмы числа документов и длины списка вхождений хранятся готовыми
+  // и обновляются при изменении индекса
+  if (statistics == nullptr) {
+    return log_document_count_ - postings_[term_id].GetLogSize();
+  }
+
+  // Статистика собрана без этого индекса; слово считается только по нему
+  const auto it = statistics->document_freqs.find(dictionary_.GetTerm(term_id));
+  if (it == statistics->document_freqs.end()) {
+    return ComputeWordInverseDocumentFreq(term_id, nullptr);
+  }
+  // Вычисляется так же, как по собственному индексу, чтобы IDF шардов
+  // совпадал с IDF единого индекса
+  return std::log(static_cast<double>(statistics->document_count))
+    - std::log(static_cast<double>(it->second));
+}
+
+void SearchServer::SetImpactQuantization(ImpactQuantization quantization) {
+  impact_quantization_ = quantization;
+  ++generation_;
+  for (PostingList &postings : postings_) {
+    postings.SetImpactQuantization(quantization);
+  }
+}
+
+void SearchServer::SetTermFreqStorage(TermFreqStorage storage) {
+  if (storage == TermFreqStorage::COUNTS) {
+    for (const auto &[document_id, ordinal] : document_ordinals_) {
+      if (documents_[ordinal].word_count > MAX_COUNTED_WORD_COUNT) {
+        throw std::invalid_argument("Document is too long"s);
+      }
+    }
+  }
+
+  // Номера и частоты не меняются, поэтому записи кеша остаются верными
+  term_freq_storage_ = storage;
+  for (PostingList &postings : postings_) {
+    postings = PostingList();
+    postings.SetTermFreqStorage(storage);
+  }
+  for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+    const DocumentData &document = documents_[ordinal];
+    for (const auto &[term_id, count] : document.term_counts) {
+      postings_[term_id].PushBack(static_cast<int>(ordinal), count,
+        document.word_count);
+    }
+  }
+  // Квантование пересчитывается один раз после заполнения списков
+  if (impact_quantization_ != ImpactQuantization::EXACT) {
+    for (PostingList &postings : postings_) {
+      postings.SetImpactQuantization(impact_quantization_);
+    }
+  }
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+  MemoryUsage usage;
+
+  for (TermId term_id = 0; term_id < stop_word_count_; ++term_id) {
+    usage.stop_words += dictionary_.GetTermMemoryUsage(term_id);
+  }
+  usage.term_dictionary = dictionary_.GetMemoryUsage() - usage.stop_words;
+
+  usage.postings = postings_.capacity() * sizeof(PostingList);
+  for (const PostingList &postings : postings_) {
+    usage.postings += postings.GetMemoryUsage();
+  }
+
+  for (const DocumentData &document : documents_) {
+    usage.forward_index += document.term_counts.capacity() * sizeof(TermCount);
+  }
+
+  usage.document_table = documents_.capacity() * sizeof(DocumentData)
+    + attributes_.GetMemoryUsage()
+    + document_ordinals_.size()
+      * (sizeof(std::pair<const int, int>) + TREE_NODE_OVERHEAD)
+    + documents_ids_.size() * (sizeof(int) + TREE_NODE_OVERHEAD);
+
+  usage.texts = texts_.GetCapacity();
+  return usage;
+}
+
+void SearchServer::ResizePostings() {
+  const size_t old_size = postings_.size();
+  postings_.resize(dictionary_.size());
+  for (size_t term_id = old_size; term_id < postings_.size(); ++term_id) {
+    postings_[term_id].SetTermFreqStorage(term_freq_storage_);
+    postings_[term_id].SetImpactQuantization(impact_quantization_);
+  }
+}
+
+void SearchServer::UpdateLogDocumentCount() {
+  const int document_count = GetDocumentCount();
+  log_document_count_ = document_count == 0
+    ? 0.0 : std::log(static_cast<double>(document_count));
+}
+
+void SelectTopDocuments(std::vector<Document> &documents) {
+  PROFILE_SCOPE("sort");
+  // Равные документы упорядочиваются по идентификатору, чтобы результат не
+  // зависел от того, в каком порядке и какими частями найдены кандидаты
+  std::sort(documents.begin(), documents.end(),
+    [](const Document& lhs, const Document& rhs) {
+      if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+      } else if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+      } else {
+        return lhs.id < rhs.id;
+      }
+    });
+  if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+    documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+  }
+}
+
+int SearchServer::GetScoringChunkSize(bool is_parallel) const {
+  if (!is_parallel) {
+    return MAX_SCORING_CHUNK_SIZE;
+  }
+
+  // Несколько частей на поток, чтобы выровнять нагрузку
+  const int part_count =
+    4 * std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  const int chunk_size =
+    static_cast<int>(documents_.size()) / part_count + 1;
+
+  return std::clamp(chunk_size, MIN_SCORING_CHUNK_SIZE,
+    MAX_SCORING_CHUNK_SIZE);
+}
+
+std::vector<std::string_view> SearchServer::GetMatchedWords(
+  std::vector<TermId> term_ids) const {
+  std::vector<std::string_view> words;
+  words.reserve(term_ids.size());
+
+  for (const TermId term_id : term_ids) {
+    words.push_back(dictionary_.GetTerm(term_id));
+  }
+  std::sort(words.begin(), words.end());
+
+  return words;
 }
@@ -1,21 +1,89 @@
 #pragma once
 
-#include "concurrent_map.h"
 #include "document.h"
+#include "document_attributes.h"
+#include "posting_list.h"
+#include "profiler.h"
+#include "query_cache.h"
+#include "query_limits.h"
+#include "relevance_accumulator.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "text_arena.h"
+#include "thread_pool.h"
+#include "word_frequencies.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <exception>
 #include <execution>
 #include <stdexcept>
 #include <map>
+#include <memory>
 #include <numeric>
+#include <queue>
 #include <set>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const auto EPSILON = 1e-6;
+const size_t MAX_PRUNED_QUERY_WORD_COUNT = 16;
+// Наибольшее число запросов пакета в одном общем проходе по спискам
+// вхождений; ограничивает память под найденные документы
+const size_t MAX_SHARED_SCAN_QUERY_COUNT = 1024;
+// Сигнатура MinHash для поиска почти совпадающих документов делится на
+// MINHASH_BAND_COUNT полос по MINHASH_ROW_COUNT значений; документы,
+// совпавшие хотя бы в одной полосе, сравниваются точно
+const size_t MINHASH_BAND_COUNT = 16;
+const size_t MINHASH_ROW_COUNT = 4;
+
+// Статистика коллекции для вычисления IDF. Шардированный сервер суммирует
+// статистику шардов, чтобы релевантность совпадала с единым индексом
+struct CorpusStatistics {
+  int document_count = 0;
+  // Число документов, содержащих слово
+  std::map<std::string, int, std::less<>> document_freqs;
+};
+
+// Память, занятая структурами индекса, в байтах. Учитывается выделенная
+// ёмкость контейнеров; размер узлов std::map и std::set оценивается как
+// размер значения и служебных указателей узла
+struct MemoryUsage {
+  // Хеш-таблица и тексты термов, кроме стоп-слов
+  size_t term_dictionary = 0;
+  size_t stop_words = 0;
+  // Списки вхождений, включая квантованные частоты и битовые карты
+  size_t postings = 0;
+  // Числа вхождений термов по документам
+  size_t forward_index = 0;
+  // Записи и атрибуты документов, соответствие идентификаторов номерам
+  size_t document_table = 0;
+  size_t texts = 0;
+
+  [[nodiscard]] size_t GetTotal() const {
+    return term_dictionary + stop_words + postings + forward_index
+      + document_table + texts;
+  }
+};
+
+// Упорядочивает документы по убыванию релевантности, при равной
+// релевантности - по убыванию рейтинга, затем по возрастанию
+// идентификатора, и оставляет MAX_RESULT_DOCUMENT_COUNT лучших
+void SelectTopDocuments(std::vector<Document> &documents);
+
+// Способ вычисления FindTopDocuments с последовательной политикой
+enum class QueryEvaluation {
+  // Оценка всех документов, содержащих хотя бы одно плюс-слово
+  EXHAUSTIVE,
+  // Обход документов по порядку с пропуском тех, чья верхняя граница
+  // релевантности (по спискам и по блокам) не позволяет войти в результат
+  BLOCK_MAX_WAND,
+};
 
 class SearchServer {
 public:
@@ -27,8 +95,9 @@ public:
     return documents_ids_.end();
   }
 
-  [[nodiscard]] const std::map<std::string_view, double>
-  &GetWordFrequencies(int document_id) const;
+  // Частоты слов документа без копирования; пустое представление, если
+  // документа нет
+  [[nodiscard]] WordFrequencies GetWordFrequencies(int document_id) const;
 
   void RemoveDocument(int document_id);
 
@@ -36,14 +105,41 @@ public:
   template <typename ExecutionPolicy>
   void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
+  // Удаляет несколько документов сразу: каждый затронутый список вхождений
+  // перестраивается один раз. Отсутствующие идентификаторы пропускаются
+  template <typename ExecutionPolicy>
+  void RemoveDocuments(ExecutionPolicy &&policy,
+    const std::vector<int> &document_ids);
+
+  void RemoveDocuments(const std::vector<int> &document_ids);
+
+  // Идентификаторы документов (по возрастанию), набор слов которых
+  // совпадает с набором слов документа с меньшим идентификатором.
+  // При similarity_threshold < 1 дубликатом считается и документ, сходство
+  // Жаккара которого с документом с меньшим идентификатором не ниже порога;
+  // кандидаты отбираются по MinHash, поэтому отдельные пары с сходством чуть
+  // выше порога могут быть пропущены
+  template <typename ExecutionPolicy>
+  std::vector<int> FindDuplicates(ExecutionPolicy &&policy,
+    double similarity_threshold = 1.0) const;
+
   template <typename StringContainer>
-  explicit SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+  explicit SearchServer(const StringContainer& stop_words) {
     using std::string_literals::operator""s;
 
-    if(!(std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord))) {
+    const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+    if(!(std::all_of(unique_stop_words.begin(), unique_stop_words.end(),
+      IsValidWord))) {
       throw std::invalid_argument("Special character detected"s);
     }
+
+    // Стоп-слова добавляются в словарь первыми и занимают идентификаторы
+    // [0, stop_word_count_)
+    for (const std::string &word : unique_stop_words) {
+      dictionary_.Intern(word);
+    }
+    stop_word_count_ = dictionary_.size();
+    postings_.resize(stop_word_count_);
   }
 
   explicit SearchServer(const std::string &stop_words_text)
@@ -55,6 +151,33 @@ public:
   void AddDocument(int document_id, std::string_view document,
     DocumentStatus status, const std::vector<int> &ratings);
 
+  // Пакетное добавление: тексты разбираются параллельно, вхождения всех
+  // документов сливаются в списки одним проходом. Идентификаторы и тексты
+  // проверяются до изменения индекса, поэтому при ошибке индекс остаётся
+  // прежним. Результат совпадает с последовательными вызовами AddDocument
+  template <typename ExecutionPolicy>
+  void AddDocuments(ExecutionPolicy &&policy,
+    const std::vector<DocumentInput> &documents);
+
+  void AddDocuments(const std::vector<DocumentInput> &documents);
+
+  // Освобождает память удалённых документов: тексты живых документов
+  // переписываются в новое хранилище, порядковые номера уплотняются, списки
+  // вхождений перестраиваются. Результаты поиска не меняются, курсоры
+  // становятся недействительными
+  template <typename ExecutionPolicy>
+  void Compact(ExecutionPolicy &&policy);
+
+  void Compact();
+
+  // Сохраняет индекс целиком (словарь, списки вхождений, документы и
+  // стоп-слова) в двоичный снимок
+  void SaveSnapshot(const std::string &path) const;
+
+  // Создаёт сервер из снимка, сохранённого SaveSnapshot. Файл отображается
+  // в память и копируется готовыми массивами, без разбора текстов документов
+  static SearchServer OpenSnapshot(const std::string &path);
+
   template <typename ExecutionPolicy, typename Predicate>
   std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
     std::string_view raw_query, Predicate predicate) const;
@@ -71,13 +194,124 @@ public:
   std::vector<Document> FindTopDocuments(std::string_view raw_query,
     Predicate predicate) const;
 
+  // Поиск, в котором IDF слов вычисляется по статистике statistics вместо
+  // собственного индекса. Кеш результатов не используется
+  template <typename ExecutionPolicy, typename Predicate>
+  std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, Predicate predicate,
+    const CorpusStatistics &statistics) const;
+
+  // Поиск с ограничением времени и отменой (QueryLimits). При превышении
+  // возвращаются лучшие документы среди оценённых к этому моменту или пустой
+  // результат, в обоих случаях с признаком truncated. Прерванный результат
+  // не попадает в кеш
+  template <typename ExecutionPolicy, typename Predicate>
+  SearchResult FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, Predicate predicate,
+    const QueryLimits &limits) const;
+
+  template <typename ExecutionPolicy>
+  SearchResult FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, DocumentStatus requested_status,
+    const QueryLimits &limits) const;
+
+  template <typename ExecutionPolicy>
+  SearchResult FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, const QueryLimits &limits) const;
+
+  // Добавляет в statistics число документов индекса и число документов,
+  // содержащих каждое плюс-слово запроса
+  void CollectCorpusStatistics(std::string_view raw_query,
+    CorpusStatistics &statistics) const;
+
   std::vector<Document> FindTopDocuments(std::string_view raw_query,
     DocumentStatus requested_status) const;
 
   std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+  // Пакетный поиск: результат i совпадает с FindTopDocuments(queries[i],
+  // status). Каждый запрос разбирается один раз, запросы с одинаковым
+  // набором плюс- и минус-слов оцениваются один раз. Запросы с отсечением
+  // оцениваются параллельно друг другу; запросы без отсечения - общим
+  // проходом, в котором список вхождений каждого слова пакета читается
+  // один раз. Результаты берутся из кеша и попадают в него.
+  // StringContainer - контейнер строк с произвольным доступом
+  template <typename ExecutionPolicy, typename StringContainer>
+  std::vector<std::vector<Document>> FindTopDocumentsBatch(
+    ExecutionPolicy &&policy, const StringContainer &raw_queries,
+    DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+  // Пакетный поиск с общими для всех запросов ограничениями: запросы,
+  // до которых очередь дошла после срока, возвращаются пустыми с признаком
+  // truncated
+  template <typename ExecutionPolicy, typename StringContainer>
+  std::vector<SearchResult> FindTopDocumentsBatch(ExecutionPolicy &&policy,
+    const StringContainer &raw_queries, DocumentStatus status,
+    const QueryLimits &limits) const;
+
   int GetDocumentCount() const;
 
+  // Курсор по документам, содержащим слово. Курсор перечисляет внутренние
+  // порядковые номера документов и действителен до изменения индекса
+  PostingCursor GetPostingCursor(std::string_view word) const;
+
+  // Идентификатор документа по внутреннему порядковому номеру
+  int GetDocumentId(int ordinal) const;
+
+  // Параллельные версии FindTopDocuments всегда оценивают документы
+  // полностью; результат не зависит от выбранного способа
+  void SetQueryEvaluation(QueryEvaluation query_evaluation) {
+    query_evaluation_ = query_evaluation;
+  }
+
+  // Оценка по квантованным частотам терма (см. ImpactQuantization):
+  // вклады слов складываются из 8- или 16-битных значений блоками, без
+  // обращения к точным частотам. EXACT возвращает точную оценку. Влияет на
+  // все способы вычисления FindTopDocuments и делает записи кеша
+  // недействительными
+  void SetImpactQuantization(ImpactQuantization quantization);
+
+  [[nodiscard]] ImpactQuantization GetImpactQuantization() const {
+    return impact_quantization_;
+  }
+
+  // Способ хранения частот в списках вхождений (см. TermFreqStorage).
+  // Списки перестраиваются по прямому индексу; результаты поиска не
+  // меняются. Бросает std::invalid_argument, если для COUNTS в каком-либо
+  // документе больше MAX_COUNTED_WORD_COUNT слов; такие документы нельзя
+  // и добавить, пока действует COUNTS
+  void SetTermFreqStorage(TermFreqStorage storage);
+
+  [[nodiscard]] TermFreqStorage GetTermFreqStorage() const {
+    return term_freq_storage_;
+  }
+
+  [[nodiscard]] MemoryUsage GetMemoryUsage() const;
+
+  // Кеш результатов FindTopDocuments на capacity запросов; 0 отключает кеш.
+  // Кешируются только запросы с отбором по статусу, результаты запросов с
+  // произвольным предикатом вычисляются всегда. Любое изменение индекса
+  // делает прежние записи недействительными
+  void SetQueryCacheCapacity(size_t capacity) {
+    query_cache_ = QueryCache(capacity);
+  }
+
+  [[nodiscard]] QueryCache::Stats GetQueryCacheStats() const {
+    return query_cache_.GetStats();
+  }
+
+  // Пул потоков, на котором выполняются вызовы с std::execution::par;
+  // nullptr - параллельные алгоритмы стандартной библиотеки. Копии сервера
+  // используют тот же пул. Вызовы с ThreadPoolPolicy выполняются на пуле
+  // из политики независимо от этой настройки
+  void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = std::move(thread_pool);
+  }
+
+  [[nodiscard]] const std::shared_ptr<ThreadPool> &GetThreadPool() const {
+    return thread_pool_;
+  }
+
   std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
     std::string_view raw_query, int document_id) const;
   std::tuple<std::vector<std::string_view>, DocumentStatus>
@@ -86,95 +320,864 @@ public:
   std::tuple<std::vector<std::string_view>, DocumentStatus>
   MatchDocument(const std::execution::parallel_policy&,
     std::string_view raw_query,int document_id) const;
+  std::tuple<std::vector<std::string_view>, DocumentStatus>
+  MatchDocument(const ThreadPoolPolicy &policy,
+    std::string_view raw_query, int document_id) const;
+
+  using MatchResult = std::tuple<std::vector<std::string_view>,
+    DocumentStatus>;
+
+  // Результат MatchDocument для каждого документа: results[i] относится к
+  // document_ids[i]. Запрос разбирается один раз, слова запроса
+  // пересекаются с прямым индексом документа; параллельная политика делит
+  // между потоками документы, а не слова. results переиспользуется: векторы
+  // слов очищаются с сохранением выделенной памяти. Бросает
+  // std::out_of_range, если документа нет, до изменения results
+  template <typename ExecutionPolicy>
+  void MatchDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
+    const std::vector<int> &document_ids,
+    std::vector<MatchResult> &results) const;
+  void MatchDocuments(std::string_view raw_query,
+    const std::vector<int> &document_ids,
+    std::vector<MatchResult> &results) const;
 
 private:
+  SearchServer() = default;
+
+  // Идентификатор, рейтинг и статус документа хранятся в attributes_
   struct DocumentData {
-    int rating;
-    DocumentStatus status;
-    std::string data;
+    // Текст документа в texts_
+    TextArena::Handle text;
+    // Число слов документа без стоп-слов
+    uint32_t word_count = 0;
+    // Прямой индекс: число вхождений термов документа по возрастанию
+    // идентификатора; частота терма - count / word_count
+    std::vector<TermCount> term_counts;
   };
 
   struct QueryWord {
-    std::string_view data;
+    // TermDictionary::NO_TERM, если слова нет ни в одном документе
+    TermId term_id;
     bool is_minus;
     bool is_stop;
   };
 
+  // Ограничения одного запроса во время оценки. Превышение запоминается,
+  // чтобы остановились все потоки, оценивающие запрос
+  class QueryBudget {
+  public:
+    explicit QueryBudget(const QueryLimits &limits)
+      : limits_(limits) {
+    }
+
+    [[nodiscard]] const QueryLimits &GetLimits() const {
+      return limits_;
+    }
+
+    [[nodiscard]] bool IsExhausted() const {
+      if (is_exhausted_.load(std::memory_order_relaxed)) {
+        return true;
+      }
+      if (limits_.IsExceeded()) {
+        is_exhausted_.store(true, std::memory_order_relaxed);
+        return true;
+      }
+      return false;
+    }
+
+    // Превышение уже было обнаружено, без новой проверки
+    [[nodiscard]] bool WasExhausted() const {
+      return is_exhausted_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    const QueryLimits &limits_;
+    mutable std::atomic<bool> is_exhausted_ = false;
+  };
+
+  // Документы с минус-словами запроса: готовые битовые карты частых слов
+  // и карта, собранная из списков вхождений остальных
+  struct MinusDocuments {
+    std::vector<const DocumentBitmap *> bitmaps;
+    DocumentBitmap collected;
+
+    bool Contains(int ordinal) const {
+      return collected.Contains(ordinal)
+        || std::any_of(bitmaps.begin(), bitmaps.end(),
+          [ordinal](const DocumentBitmap *bitmap) {
+            return bitmap->Contains(ordinal);
+          });
+    }
+  };
+
   struct Query {
-    std::vector<std::string_view> plus_words;
-    std::vector<std::string_view> minus_words;
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    // Статистика для IDF; nullptr - статистика собственного индекса
+    const CorpusStatistics *statistics = nullptr;
+    // Ограничения времени; nullptr - без ограничений
+    const QueryBudget *budget = nullptr;
+
+    // Время запроса вышло или он отменён
+    bool IsExhausted() const {
+      return budget != nullptr && budget->IsExhausted();
+    }
+
+    bool operator==(const Query &other) const {
+      return plus_terms == other.plus_terms
+        && minus_terms == other.minus_terms;
+    }
+
+    bool operator<(const Query &other) const {
+      return std::tie(plus_terms, minus_terms)
+        < std::tie(other.plus_terms, other.minus_terms);
+    }
   };
 
-  std::set<std::string> stop_words_;
-  std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-  std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-  std::map<int, DocumentData> documents_;
+  TermDictionary dictionary_;
+  size_t stop_word_count_ = 0;
+  // Списки вхождений по идентификатору терма
+  std::vector<PostingList> postings_;
+  // Документы по внутреннему порядковому номеру. Номера выдаются по порядку
+  // добавления и не переиспользуются, поэтому новый документ всегда попадает
+  // в конец списков вхождений
+  std::vector<DocumentData> documents_;
+  // Атрибуты документов по тому же порядковому номеру
+  DocumentAttributes attributes_;
+  TextArena texts_;
+  std::map<int, int> document_ordinals_;
   std::set<int> documents_ids_;
+  QueryEvaluation query_evaluation_ = QueryEvaluation::BLOCK_MAX_WAND;
+  ImpactQuantization impact_quantization_ = ImpactQuantization::EXACT;
+  TermFreqStorage term_freq_storage_ = TermFreqStorage::DOUBLE;
+  // Логарифм числа документов для IDF
+  double log_document_count_ = 0.0;
+  // Увеличивается при каждом изменении набора документов
+  uint64_t generation_ = 0;
+  mutable QueryCache query_cache_;
+  std::shared_ptr<ThreadPool> thread_pool_;
 
   static bool IsValidWord(std::string_view word);
   bool IsStopWord(std::string_view word) const;
+  bool IsStopWord(TermId term_id) const;
   std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+  // Документ с этим номером не удалён
+  bool IsLive(int ordinal) const;
   static int ComputeAverageRating(const std::vector<int> &ratings);
-  QueryWord ParseQueryWord(std::string_view text) const;
+  // Дополняет списки вхождений до размера словаря; новые списки получают
+  // текущие режимы квантования и хранения частот
+  void ResizePostings();
+  void UpdateLogDocumentCount();
+  void ValidateDocumentIds(const std::vector<DocumentInput> &documents) const;
+  // Числа вхождений термов документа по списку идентификаторов всех его слов
+  static std::vector<TermCount> ComputeTermCounts(std::vector<TermId> term_ids);
+  // Хеш набора термов документа; разные seed дают независимые хеши
+  static uint64_t HashTerms(const std::vector<TermCount> &term_counts,
+    uint64_t seed);
+  static std::array<uint64_t, MINHASH_BAND_COUNT * MINHASH_ROW_COUNT>
+  ComputeMinHash(const std::vector<TermCount> &term_counts);
+  // Сходство Жаккара наборов термов двух документов
+  static double ComputeJaccardSimilarity(
+    const std::vector<TermCount> &lhs,
+    const std::vector<TermCount> &rhs);
+  static bool HasSameTerms(const std::vector<TermCount> &lhs,
+    const std::vector<TermCount> &rhs);
+  QueryWord ParseQueryWord(std::string_view text, bool check_characters) const;
   Query ParseQuery(std::string_view text, bool=true) const;
-  double ComputeWordInverseDocumentFreq(std::string_view word) const;
+  double ComputeWordInverseDocumentFreq(TermId term_id,
+    const CorpusStatistics *statistics) const;
+  // Размер части диапазона документов, оцениваемой одним потоком
+  int GetScoringChunkSize(bool is_parallel) const;
+  // Слова запроса, встречающиеся в документе, в лексикографическом порядке
+  std::vector<std::string_view> GetMatchedWords(
+    std::vector<TermId> term_ids) const;
+
+  // Политика, которой выполняются алгоритмы: std::execution::par заменяется
+  // политикой пула сервера, остальные политики не меняются
+  template <typename ExecutionPolicy>
+  auto ResolvePolicy(ExecutionPolicy &&policy) const;
+
+  // Результат поиска с ограничениями по найденным документам
+  static SearchResult MakeSearchResult(std::vector<Document> documents,
+    const QueryBudget &budget);
+
+  // Общая часть пакетного поиска; limits == nullptr - без ограничений
+  template <typename ExecutionPolicy, typename StringContainer>
+  std::vector<SearchResult> EvaluateQueryBatch(ExecutionPolicy &&policy,
+    const StringContainer &raw_queries, DocumentStatus status,
+    const QueryLimits *limits) const;
+
+  // FindTopDocumentsForQuery с отбором по статусу через кеш результатов
+  template <typename ExecutionPolicy>
+  std::vector<Document> FindTopDocumentsCached(ExecutionPolicy &&policy,
+    const Query &query, DocumentStatus requested_status) const;
+
+  template <typename ExecutionPolicy, typename Predicate>
+  std::vector<Document> FindTopDocumentsForQuery(ExecutionPolicy &&policy,
+    const Query &query, Predicate predicate) const;
 
   template <typename ExecutionPolicy, typename Predicate>
   std::vector<Document> FindAllDocuments(ExecutionPolicy &&policy,
     const Query& query, Predicate predicate) const;
+
+  // FindAllDocuments для нескольких запросов за один проход: вхождения
+  // каждого терма в части диапазона декодируются один раз и складываются
+  // в накопитель каждого запроса, где встречается терм
+  template <typename ExecutionPolicy>
+  std::vector<std::vector<Document>> FindAllDocumentsShared(
+    ExecutionPolicy &&policy, const std::vector<const Query *> &queries,
+    DocumentStatus status) const;
+
+  // Запрос оценивается последовательным проходом с отсечением
+  bool UsesPruning(const Query &query) const {
+    return query_evaluation_ == QueryEvaluation::BLOCK_MAX_WAND
+      && query.plus_terms.size() <= MAX_PRUNED_QUERY_WORD_COUNT;
+  }
+
+  // Возвращает документы, которые могут войти в MAX_RESULT_DOCUMENT_COUNT
+  // лучших; после сортировки результат совпадает с FindAllDocuments
+  template <typename Predicate>
+  std::vector<Document> FindTopDocumentsPruned(const Query& query,
+    Predicate predicate) const;
+
+  MinusDocuments CollectMinusDocuments(const Query &query) const;
+  // Сопоставляет разобранный запрос одному документу для MatchDocuments
+  void MatchOrdinal(const Query &query, int ordinal,
+    MatchResult &result) const;
+
+  // Проверяет документ предикатом; отбор по статусу - проверка бита
+  template <typename Predicate>
+  bool IsAccepted(const Predicate &predicate, int ordinal) const;
 };
 
+template <typename Predicate>
+bool SearchServer::IsAccepted(const Predicate &predicate, int ordinal) const {
+  if constexpr (IS_STATUS_PREDICATE<Predicate>) {
+    return attributes_.HasStatus(ordinal, predicate.status);
+  } else {
+    return predicate(attributes_.GetId(ordinal),
+      attributes_.GetStatus(ordinal), attributes_.GetRating(ordinal));
+  }
+}
+
+template <typename ExecutionPolicy>
+auto SearchServer::ResolvePolicy(ExecutionPolicy &&policy) const {
+  if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>,
+    std::execution::parallel_policy>) {
+    return thread_pool_ ? ThreadPoolPolicy(*thread_pool_) : ThreadPoolPolicy();
+  } else {
+    return std::decay_t<ExecutionPolicy>(policy);
+  }
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::MatchDocuments(ExecutionPolicy &&policy,
+  const std::string_view raw_query, const std::vector<int> &document_ids,
+  std::vector<MatchResult> &results) const {
+  PROFILE_SCOPE("MatchDocuments");
+
+  const Query query = ParseQuery(raw_query);
+  std::vector<int> ordinals;
+  ordinals.reserve(document_ids.size());
+  for (const int document_id : document_ids) {
+    ordinals.push_back(document_ordinals_.at(document_id));
+  }
+
+  results.resize(document_ids.size());
+  std::vector<size_t> indexes(document_ids.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  ForEach(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+    [this, &query, &ordinals, &results](size_t index) {
+      MatchOrdinal(query, ordinals[index], results[index]);
+    });
+}
+
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-  if (document_to_word_freqs_.count(document_id) == 0) {
+  PROFILE_SCOPE("RemoveDocument");
+  if (document_ordinals_.count(document_id) == 0) {
     return;
   }
 
-  const auto &word_freq = document_to_word_freqs_.at(document_id);
-  std::vector<std::string_view> words(word_freq.size());
+  const int ordinal = document_ordinals_.at(document_id);
+  auto &document = documents_[ordinal];
+  ++generation_;
 
-  std::transform(policy, word_freq.begin(), word_freq.end(), words.begin(),
-    [](const std::pair<const std::string_view, double> &el){
-      return el.first;
+  ForEach(ResolvePolicy(policy), document.term_counts.begin(),
+    document.term_counts.end(),
+    [this, ordinal](const TermCount &el){
+      postings_[el.term_id].Erase(ordinal);
     });
 
-  std::for_each(policy, words.begin(), words.end(),
-    [this, document_id](const std::string_view key){
-      word_to_document_freqs_.at(key).erase(document_id);
+  // Порядковый номер документа не переиспользуется, от записи остаётся
+  // только идентификатор
+  texts_.Release(document.text);
+  document.term_counts = std::vector<TermCount>();
+  attributes_.Remove(ordinal);
+  document_ordinals_.erase(document_id);
+  documents_ids_.erase(document_id);
+  UpdateLogDocumentCount();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy &&policy,
+  const std::vector<int> &document_ids) {
+  PROFILE_SCOPE("RemoveDocuments");
+
+  std::vector<int> new_ordinals(documents_.size());
+  std::iota(new_ordinals.begin(), new_ordinals.end(), 0);
+  std::vector<TermId> term_ids;
+
+  for (const int document_id : document_ids) {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+      continue;
+    }
+
+    const int ordinal = it->second;
+    DocumentData &document = documents_[ordinal];
+    new_ordinals[ordinal] = -1;
+    for (const auto &[term_id, count] : document.term_counts) {
+      term_ids.push_back(term_id);
+    }
+
+    texts_.Release(document.text);
+    document.term_counts = std::vector<TermCount>();
+    attributes_.Remove(ordinal);
+    document_ordinals_.erase(it);
+    documents_ids_.erase(document_id);
+  }
+
+  UpdateLogDocumentCount();
+  if (term_ids.empty()) {
+    return;
+  }
+  ++generation_;
+
+  Sort(ResolvePolicy(policy), term_ids.begin(), term_ids.end());
+  term_ids.erase(std::unique(term_ids.begin(), term_ids.end()),
+    term_ids.end());
+
+  // Оставшиеся документы сохраняют свои номера
+  ForEach(ResolvePolicy(policy), term_ids.begin(), term_ids.end(),
+    [this, &new_ordinals](TermId term_id) {
+      postings_[term_id] = postings_[term_id].Renumber(new_ordinals);
     });
+}
 
-  document_to_word_freqs_.erase(document_id);
-  documents_.erase(document_id);
-  documents_ids_.erase(document_id);
+template <typename ExecutionPolicy>
+std::vector<int> SearchServer::FindDuplicates(ExecutionPolicy &&policy,
+  double similarity_threshold) const {
+  using std::string_literals::operator""s;
+  PROFILE_SCOPE("FindDuplicates");
+
+  if (!(similarity_threshold > 0.0 && similarity_threshold <= 1.0)) {
+    throw std::invalid_argument("Invalid similarity threshold"s);
+  }
+
+  // Документы по возрастанию идентификатора; дальше документ задаётся
+  // позицией в этом списке
+  std::vector<int> ordinals;
+  ordinals.reserve(document_ordinals_.size());
+  for (const auto &[document_id, ordinal] : document_ordinals_) {
+    ordinals.push_back(ordinal);
+  }
+  const auto terms_of = [this, &ordinals](size_t index)
+    -> const std::vector<TermCount>& {
+    return documents_[ordinals[index]].term_counts;
+  };
+
+  std::vector<size_t> indexes(ordinals.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  std::vector<uint8_t> is_duplicate(ordinals.size(), 0);
+
+  if (similarity_threshold == 1.0) {
+    // Документы группируются по 128-битному отпечатку набора термов;
+    // точное сравнение нужно только внутри группы
+    struct Fingerprint {
+      uint64_t high;
+      uint64_t low;
+      size_t index;
+
+      bool operator<(const Fingerprint &other) const {
+        return std::tie(high, low, index)
+          < std::tie(other.high, other.low, other.index);
+      }
+    };
+
+    std::vector<Fingerprint> fingerprints(ordinals.size());
+    Transform(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+      fingerprints.begin(), [&terms_of](size_t index) {
+        return Fingerprint{
+          HashTerms(terms_of(index), 0),
+          HashTerms(terms_of(index), 1),
+          index
+        };
+      });
+    Sort(ResolvePolicy(policy), fingerprints.begin(), fingerprints.end());
+
+    std::vector<size_t> group_starts;
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+      if (i == 0 || fingerprints[i].high != fingerprints[i - 1].high
+        || fingerprints[i].low != fingerprints[i - 1].low) {
+        group_starts.push_back(i);
+      }
+    }
+    group_starts.push_back(fingerprints.size());
+
+    std::vector<size_t> groups(group_starts.size() - 1);
+    std::iota(groups.begin(), groups.end(), 0);
+    ForEach(ResolvePolicy(policy), groups.begin(), groups.end(),
+      [&fingerprints, &group_starts, &is_duplicate, &terms_of](size_t group) {
+        const size_t begin = group_starts[group];
+        const size_t end = group_starts[group + 1];
+        // Дубликат совпадает и с тем документом, копией которого он
+        // является, поэтому сравнивать достаточно с оставляемыми
+        for (size_t i = begin + 1; i < end; ++i) {
+          const size_t index = fingerprints[i].index;
+          for (size_t j = begin; j < i; ++j) {
+            const size_t other = fingerprints[j].index;
+            if (!is_duplicate[other]
+              && HasSameTerms(terms_of(index), terms_of(other))) {
+              is_duplicate[index] = 1;
+              break;
+            }
+          }
+        }
+      });
+  } else {
+    // Документы с совпадающей полосой сигнатуры MinHash - кандидаты
+    struct BandKey {
+      uint64_t hash;
+      size_t index;
+
+      bool operator<(const BandKey &other) const {
+        return std::tie(hash, index) < std::tie(other.hash, other.index);
+      }
+    };
+
+    std::vector<BandKey> band_keys(ordinals.size() * MINHASH_BAND_COUNT);
+    ForEach(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+      [&band_keys, &terms_of](size_t index) {
+        const auto signature = ComputeMinHash(terms_of(index));
+        for (size_t band = 0; band < MINHASH_BAND_COUNT; ++band) {
+          uint64_t hash = band;
+          for (size_t row = 0; row < MINHASH_ROW_COUNT; ++row) {
+            hash = hash * 0x100000001b3ULL
+              ^ signature[band * MINHASH_ROW_COUNT + row];
+          }
+          band_keys[index * MINHASH_BAND_COUNT + band] = {hash, index};
+        }
+      });
+
+    std::vector<BandKey> sorted_keys = band_keys;
+    Sort(ResolvePolicy(policy), sorted_keys.begin(), sorted_keys.end());
+
+    ForEach(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+      [&band_keys, &sorted_keys, &is_duplicate, &terms_of,
+        similarity_threshold](size_t index) {
+        for (size_t band = 0; band < MINHASH_BAND_COUNT
+          && !is_duplicate[index]; ++band) {
+          const uint64_t hash = band_keys[index * MINHASH_BAND_COUNT + band].hash;
+          // Документы с меньшим идентификатором в той же корзине
+          auto it = std::lower_bound(sorted_keys.begin(), sorted_keys.end(),
+            BandKey{hash, 0});
+          for (; it != sorted_keys.end() && it->hash == hash
+            && it->index < index; ++it) {
+            if (ComputeJaccardSimilarity(terms_of(index),
+              terms_of(it->index)) >= similarity_threshold) {
+              is_duplicate[index] = 1;
+              break;
+            }
+          }
+        }
+      });
+  }
+
+  std::vector<int> duplicates;
+  for (size_t index = 0; index < ordinals.size(); ++index) {
+    if (is_duplicate[index]) {
+      duplicates.push_back(attributes_.GetId(ordinals[index]));
+    }
+  }
+  return duplicates;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocuments(ExecutionPolicy &&policy,
+  const std::vector<DocumentInput> &documents) {
+  using std::string_literals::operator""s;
+  PROFILE_SCOPE("AddDocuments");
+
+  ValidateDocumentIds(documents);
+
+  // Разбор текстов. Исключение внутри параллельного алгоритма завершило бы
+  // программу, поэтому ошибка только отмечается
+  struct ParsedDocument {
+    std::vector<std::string_view> words;
+    std::vector<TermId> term_ids;
+    bool is_valid = true;
+  };
+  std::vector<ParsedDocument> parsed(documents.size());
+
+  Transform(ResolvePolicy(policy), documents.begin(), documents.end(),
+    parsed.begin(),
+    [this](const DocumentInput &document) {
+      ParsedDocument result;
+      try {
+        result.words = SplitIntoWordsNoStop(document.text);
+      } catch (const std::invalid_argument &) {
+        result.is_valid = false;
+      }
+      return result;
+    });
+
+  if (!std::all_of(parsed.begin(), parsed.end(),
+    [](const ParsedDocument &document) { return document.is_valid; })) {
+    throw std::invalid_argument("Special character detected"s);
+  }
+  if (term_freq_storage_ == TermFreqStorage::COUNTS
+    && std::any_of(parsed.begin(), parsed.end(),
+      [](const ParsedDocument &document) {
+        return document.words.size() > MAX_COUNTED_WORD_COUNT;
+      })) {
+    throw std::invalid_argument("Document is too long"s);
+  }
+
+  // Известные термы ищутся параллельно, новые добавляются в словарь по
+  // порядку документов и слов, как при последовательном добавлении
+  ForEach(ResolvePolicy(policy), parsed.begin(), parsed.end(),
+    [this](ParsedDocument &document) {
+      document.term_ids.reserve(document.words.size());
+      for (const std::string_view word : document.words) {
+        document.term_ids.push_back(dictionary_.Find(word));
+      }
+    });
+
+  for (ParsedDocument &document : parsed) {
+    for (size_t i = 0; i < document.words.size(); ++i) {
+      if (document.term_ids[i] == TermDictionary::NO_TERM) {
+        document.term_ids[i] = dictionary_.Intern(document.words[i]);
+      }
+    }
+  }
+  ResizePostings();
+
+  std::vector<std::vector<TermCount>> term_counts(documents.size());
+  Transform(ResolvePolicy(policy), parsed.begin(), parsed.end(),
+    term_counts.begin(),
+    [](ParsedDocument &document) {
+      return ComputeTermCounts(std::move(document.term_ids));
+    });
+
+  // Вхождения пакета упорядочиваются по терму с сохранением порядка
+  // номеров документов, после чего каждый список дополняется независимо
+  struct Posting {
+    TermId term_id;
+    int ordinal;
+    uint32_t count;
+    uint32_t word_count;
+  };
+
+  ++generation_;
+  const int first_ordinal = static_cast<int>(documents_.size());
+  std::vector<Posting> postings;
+  for (size_t i = 0; i < term_counts.size(); ++i) {
+    const auto word_count = static_cast<uint32_t>(parsed[i].words.size());
+    for (const auto &[term_id, count] : term_counts[i]) {
+      postings.push_back({
+        term_id,
+        first_ordinal + static_cast<int>(i),
+        count,
+        word_count
+      });
+    }
+  }
+
+  StableSort(ResolvePolicy(policy), postings.begin(), postings.end(),
+    [](const Posting &lhs, const Posting &rhs) {
+      return lhs.term_id < rhs.term_id;
+    });
+
+  std::vector<size_t> term_starts;
+  for (size_t i = 0; i < postings.size(); ++i) {
+    if (i == 0 || postings[i].term_id != postings[i - 1].term_id) {
+      term_starts.push_back(i);
+    }
+  }
+  term_starts.push_back(postings.size());
+
+  std::vector<size_t> terms(term_starts.size() - 1);
+  std::iota(terms.begin(), terms.end(), 0);
+  ForEach(ResolvePolicy(policy), terms.begin(), terms.end(),
+    [this, &postings, &term_starts](size_t term) {
+      for (size_t i = term_starts[term]; i < term_starts[term + 1]; ++i) {
+        postings_[postings[i].term_id].PushBack(postings[i].ordinal,
+          postings[i].count, postings[i].word_count);
+      }
+    });
+
+  for (size_t i = 0; i < documents.size(); ++i) {
+    const DocumentInput &document = documents[i];
+    documents_.push_back({
+      texts_.Add(document.text),
+      static_cast<uint32_t>(parsed[i].words.size()),
+      std::move(term_counts[i])
+    });
+    attributes_.Add(document.id, ComputeAverageRating(document.ratings),
+      document.status);
+    document_ordinals_.emplace(document.id, first_ordinal + static_cast<int>(i));
+    documents_ids_.insert(document.id);
+  }
+  UpdateLogDocumentCount();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::Compact(ExecutionPolicy &&policy) {
+  std::vector<int> new_ordinals(documents_.size(), -1);
+  std::vector<DocumentData> documents;
+  documents.reserve(document_ordinals_.size());
+  DocumentAttributes attributes;
+  attributes.Reserve(document_ordinals_.size());
+  TextArena texts;
+
+  for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+    if (!IsLive(static_cast<int>(ordinal))) {
+      continue;
+    }
+    new_ordinals[ordinal] = static_cast<int>(documents.size());
+    DocumentData &document = documents_[ordinal];
+    document.text = texts.Add(texts_.Get(document.text));
+    documents.push_back(std::move(document));
+    attributes.Add(attributes_.GetId(static_cast<int>(ordinal)),
+      attributes_.GetRating(static_cast<int>(ordinal)),
+      attributes_.GetStatus(static_cast<int>(ordinal)));
+  }
+
+  ForEach(ResolvePolicy(policy), postings_.begin(), postings_.end(),
+    [&new_ordinals](PostingList &postings) {
+      postings = postings.Renumber(new_ordinals);
+    });
+
+  for (auto &[document_id, ordinal] : document_ordinals_) {
+    ordinal = new_ordinals[ordinal];
+  }
+  documents_ = std::move(documents);
+  attributes_ = std::move(attributes);
+  texts_ = std::move(texts);
 }
 
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
   const std::string_view raw_query, Predicate predicate) const {
-  const Query query = ParseQuery(raw_query);
-  auto matched_documents = FindAllDocuments(policy, query, predicate);
-  std::sort(matched_documents.begin(), matched_documents.end(),
-    [](const Document& lhs, const Document& rhs) {
-      if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-        return lhs.rating > rhs.rating;
-      } else {
-        return lhs.relevance > rhs.relevance;
-      }
-    });
-  if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-    matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+  PROFILE_SCOPE("FindTopDocuments");
+
+  Query query;
+  {
+    PROFILE_SCOPE("parse");
+    query = ParseQuery(raw_query);
+  }
+
+  return FindTopDocumentsForQuery(policy, query, predicate);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(
+  ExecutionPolicy &&policy, const Query &query, Predicate predicate) const {
+  std::vector<Document> matched_documents;
+  if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>,
+    std::execution::sequenced_policy>) {
+    // На длинных запросах поддержка порядка курсоров обходится дороже
+    // полной оценки, отсечение применяется только к коротким
+    matched_documents = UsesPruning(query)
+      ? FindTopDocumentsPruned(query, predicate)
+      : FindAllDocuments(policy, query, predicate);
+  } else {
+    matched_documents = FindAllDocuments(policy, query, predicate);
   }
+
+  SelectTopDocuments(matched_documents);
   return matched_documents;
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
   const std::string_view raw_query, DocumentStatus requested_status) const {
-  return SearchServer::FindTopDocuments(policy, raw_query,
-    [requested_status](int document_id,
-      DocumentStatus status, int rating) {
-      return requested_status == status;
+  PROFILE_SCOPE("FindTopDocuments");
+
+  Query query;
+  {
+    PROFILE_SCOPE("parse");
+    query = ParseQuery(raw_query);
+  }
+
+  return FindTopDocumentsCached(policy, query, requested_status);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsCached(
+  ExecutionPolicy &&policy, const Query &query,
+  DocumentStatus requested_status) const {
+  const DocumentStatusPredicate predicate{requested_status};
+
+  if (!query_cache_.IsEnabled()) {
+    return FindTopDocumentsForQuery(policy, query, predicate);
+  }
+
+  // Результат не зависит от политики выполнения и способа вычисления,
+  // поэтому они не входят в ключ
+  QueryCache::Key key{query.plus_terms, query.minus_terms, requested_status};
+  if (auto documents = query_cache_.Find(key, generation_)) {
+    return std::move(*documents);
+  }
+
+  auto documents = FindTopDocumentsForQuery(policy, query, predicate);
+  if (query.budget == nullptr || !query.budget->WasExhausted()) {
+    query_cache_.Insert(std::move(key), generation_, documents);
+  }
+  return documents;
+}
+
+template <typename ExecutionPolicy, typename StringContainer>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+  ExecutionPolicy &&policy, const StringContainer &raw_queries,
+  DocumentStatus status) const {
+  std::vector<SearchResult> results = EvaluateQueryBatch(policy, raw_queries,
+    status, nullptr);
+
+  std::vector<std::vector<Document>> documents(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    documents[i] = std::move(results[i].documents);
+  }
+  return documents;
+}
+
+template <typename ExecutionPolicy, typename StringContainer>
+std::vector<SearchResult> SearchServer::FindTopDocumentsBatch(
+  ExecutionPolicy &&policy, const StringContainer &raw_queries,
+  DocumentStatus status, const QueryLimits &limits) const {
+  return EvaluateQueryBatch(policy, raw_queries, status, &limits);
+}
+
+template <typename ExecutionPolicy, typename StringContainer>
+std::vector<SearchResult> SearchServer::EvaluateQueryBatch(
+  ExecutionPolicy &&policy, const StringContainer &raw_queries,
+  DocumentStatus status, const QueryLimits *limits) const {
+  PROFILE_SCOPE("FindTopDocumentsBatch");
+
+  // Исключение внутри параллельного алгоритма завершило бы программу,
+  // поэтому ошибка разбора сохраняется и бросается после него
+  std::vector<Query> queries(raw_queries.size());
+  std::vector<std::exception_ptr> errors(raw_queries.size());
+  std::vector<size_t> indexes(raw_queries.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+
+  ForEach(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+    [this, &raw_queries, &queries, &errors](size_t index) {
+      try {
+        queries[index] = ParseQuery(raw_queries[index]);
+      } catch (...) {
+        errors[index] = std::current_exception();
+      }
+    });
+
+  for (const std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // Одинаковые запросы оказываются рядом, оценивается первый из них
+  Sort(ResolvePolicy(policy), indexes.begin(), indexes.end(),
+    [&queries](size_t lhs, size_t rhs) {
+      return queries[lhs] < queries[rhs];
+    });
+
+  std::vector<size_t> unique_positions;
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    if (i == 0 || !(queries[indexes[i]] == queries[indexes[i - 1]])) {
+      unique_positions.push_back(i);
+    }
+  }
+
+  // Запросы с отсечением оцениваются каждый последовательно, параллельно -
+  // разные запросы. Запросы без отсечения, которых нет в кеше, откладываются
+  // для общего прохода по спискам вхождений. У запросов с ограничениями
+  // свой срок, они всегда оцениваются по отдельности
+  std::vector<SearchResult> results(queries.size());
+  std::vector<uint8_t> is_shared(unique_positions.size(), 0);
+  std::vector<size_t> unique_indexes(unique_positions.size());
+  std::iota(unique_indexes.begin(), unique_indexes.end(), 0);
+  ForEach(ResolvePolicy(policy), unique_indexes.begin(), unique_indexes.end(),
+    [this, &unique_positions, &indexes, &queries, &results, &is_shared,
+      status, limits](size_t unique_index) {
+      const size_t index = indexes[unique_positions[unique_index]];
+      if (limits == nullptr) {
+        if (!UsesPruning(queries[index])) {
+          if (query_cache_.IsEnabled()) {
+            QueryCache::Key key{queries[index].plus_terms,
+              queries[index].minus_terms, status};
+            if (auto documents = query_cache_.Find(key, generation_)) {
+              results[index].documents = std::move(*documents);
+              return;
+            }
+          }
+          is_shared[unique_index] = 1;
+          return;
+        }
+        results[index].documents = FindTopDocumentsCached(std::execution::seq,
+          queries[index], status);
+        return;
+      }
+
+      // Срок общий для пакета, но превышение отмечается у каждого запроса
+      const QueryBudget budget(*limits);
+      queries[index].budget = &budget;
+      results[index] = MakeSearchResult(
+        FindTopDocumentsCached(std::execution::seq, queries[index], status),
+        budget);
+      queries[index].budget = nullptr;
     });
+
+  std::vector<size_t> shared_indexes;
+  for (size_t unique_index = 0; unique_index < is_shared.size();
+    ++unique_index) {
+    if (is_shared[unique_index]) {
+      shared_indexes.push_back(indexes[unique_positions[unique_index]]);
+    }
+  }
+
+  for (size_t first = 0; first < shared_indexes.size();
+    first += MAX_SHARED_SCAN_QUERY_COUNT) {
+    const size_t last = std::min(first + MAX_SHARED_SCAN_QUERY_COUNT,
+      shared_indexes.size());
+    std::vector<const Query *> shared_queries;
+    for (size_t i = first; i < last; ++i) {
+      shared_queries.push_back(&queries[shared_indexes[i]]);
+    }
+
+    std::vector<std::vector<Document>> documents =
+      FindAllDocumentsShared(policy, shared_queries, status);
+    for (size_t i = first; i < last; ++i) {
+      const Query &query = queries[shared_indexes[i]];
+      std::vector<Document> &query_documents = documents[i - first];
+      SelectTopDocuments(query_documents);
+      if (query_cache_.IsEnabled()) {
+        query_cache_.Insert(
+          QueryCache::Key{query.plus_terms, query.minus_terms, status},
+          generation_, query_documents);
+      }
+      results[shared_indexes[i]].documents = std::move(query_documents);
+    }
+  }
+
+  for (size_t i = 1; i < indexes.size(); ++i) {
+    if (queries[indexes[i]] == queries[indexes[i - 1]]) {
+      results[indexes[i]] = results[indexes[i - 1]];
+    }
+  }
+
+  return results;
 }
 
 template <typename ExecutionPolicy>
@@ -184,6 +1187,65 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
     DocumentStatus::ACTUAL);
 }
 
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+  const std::string_view raw_query, Predicate predicate,
+  const CorpusStatistics &statistics) const {
+  PROFILE_SCOPE("FindTopDocuments");
+
+  Query query;
+  {
+    PROFILE_SCOPE("parse");
+    query = ParseQuery(raw_query);
+  }
+  query.statistics = &statistics;
+
+  return FindTopDocumentsForQuery(policy, query, predicate);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+  const std::string_view raw_query, Predicate predicate,
+  const QueryLimits &limits) const {
+  PROFILE_SCOPE("FindTopDocuments");
+
+  Query query;
+  {
+    PROFILE_SCOPE("parse");
+    query = ParseQuery(raw_query);
+  }
+  const QueryBudget budget(limits);
+  query.budget = &budget;
+
+  return MakeSearchResult(FindTopDocumentsForQuery(policy, query, predicate),
+    budget);
+}
+
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+  const std::string_view raw_query, DocumentStatus requested_status,
+  const QueryLimits &limits) const {
+  PROFILE_SCOPE("FindTopDocuments");
+
+  Query query;
+  {
+    PROFILE_SCOPE("parse");
+    query = ParseQuery(raw_query);
+  }
+  const QueryBudget budget(limits);
+  query.budget = &budget;
+
+  return MakeSearchResult(
+    FindTopDocumentsCached(policy, query, requested_status), budget);
+}
+
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy &&policy,
+  const std::string_view raw_query, const QueryLimits &limits) const {
+  return SearchServer::FindTopDocuments(policy, raw_query,
+    DocumentStatus::ACTUAL, limits);
+}
+
 template <typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(
   const std::string_view raw_query, Predicate predicate) const {
@@ -194,46 +1256,451 @@ std::vector<Document> SearchServer::FindTopDocuments(
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy &&policy,
   const Query& query, Predicate predicate) const {
-  ConcurrentMap<int, double> document_to_relevance(5000);
+  PROFILE_SCOPE("score");
 
-  std::for_each(policy, query.plus_words.begin(), query.plus_words.end(),
-    [this, predicate, &document_to_relevance](std::string_view word) {
-      if (word_to_document_freqs_.count(word) == 0) {
-        return;
+  std::vector<std::pair<const PostingList *, double>> plus_postings;
+  for (const TermId term_id : query.plus_terms) {
+    if (!postings_[term_id].empty()) {
+      plus_postings.emplace_back(&postings_[term_id],
+        ComputeWordInverseDocumentFreq(term_id, query.statistics));
+    }
+  }
+
+  // Документы с минус-словами отбрасываются при выборке из накопителя
+  // проверкой по битовым картам, без обхода вхождений минус-слов в каждой
+  // части диапазона
+  const MinusDocuments minus_documents = CollectMinusDocuments(query);
+
+  // Диапазон порядковых номеров делится на независимые части, каждая
+  // оценивается целиком одним потоком. Вклады слов в документ суммируются
+  // в порядке запроса, поэтому результат не зависит от политики
+  const int ordinal_count = static_cast<int>(documents_.size());
+  const int chunk_size = GetScoringChunkSize(
+    !std::is_same_v<std::decay_t<ExecutionPolicy>,
+      std::execution::sequenced_policy>);
+  const int chunk_count = (ordinal_count + chunk_size - 1) / chunk_size;
+
+  std::vector<int> chunks(chunk_count);
+  std::iota(chunks.begin(), chunks.end(), 0);
+  std::vector<std::vector<Document>> chunk_documents(chunk_count);
+
+  ForEach(ResolvePolicy(policy), chunks.begin(), chunks.end(),
+    [this, &query, &plus_postings, &minus_documents, &chunk_documents,
+      predicate, chunk_size, ordinal_count](int chunk) {
+      const int begin = chunk * chunk_size;
+      const int end = std::min(begin + chunk_size, ordinal_count);
+
+      static thread_local RelevanceAccumulator accumulator;
+      accumulator.Reset(end - begin);
+
+      const uint64_t *status_bitmap = nullptr;
+      if constexpr (IS_STATUS_PREDICATE<Predicate>) {
+        status_bitmap = attributes_.GetStatusBitmap(predicate.status).data();
       }
 
-      const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-      const auto docs = word_to_document_freqs_.at(word);
+      // Ограничения запроса проверяются через каждые BLOCK_SIZE вхождений.
+      // Часть, оценка которой прервана, в результат не попадает, поэтому
+      // релевантность возвращённых документов точная
+      size_t posting_count = 0;
+      const auto is_exhausted = [&query, &posting_count] {
+        return posting_count++ % PostingList::BLOCK_SIZE == 0
+          && query.IsExhausted();
+      };
+
+      for (const auto &[postings, inverse_document_freq] : plus_postings) {
+        // Квантованные частоты складываются целыми блоками; документы
+        // с другим статусом отсеиваются битовой картой статуса
+        const auto add_impacts = [&query, begin, status_bitmap,
+          inverse_document_freq = inverse_document_freq](const int *ordinals,
+          const auto *impacts, size_t count, double step) {
+          if (query.IsExhausted()) {
+            return false;
+          }
+          accumulator.AddImpacts(ordinals, begin, impacts, count, step,
+            inverse_document_freq, status_bitmap);
+          return true;
+        };
 
-      for (const auto [document_id, term_freq] : docs) {
-        const auto &document = documents_.at(document_id);
-        if (predicate(document_id, document.status, document.rating)) {
-          document_to_relevance[document_id].ref_to_value +=
-            term_freq * inverse_document_freq;
+        bool is_complete = true;
+        switch (postings->GetImpactQuantization()) {
+          case ImpactQuantization::BITS_8:
+            is_complete = postings->template ForEachImpactBlock<uint8_t>(
+              begin, end, add_impacts);
+            break;
+          case ImpactQuantization::BITS_16:
+            is_complete = postings->template ForEachImpactBlock<uint16_t>(
+              begin, end, add_impacts);
+            break;
+          default:
+            PostingCursor cursor(*postings);
+            for (cursor.AdvanceTo(begin); cursor.GetOrdinal() < end;
+              cursor.Next()) {
+              if (is_exhausted()) {
+                is_complete = false;
+                break;
+              }
+              // Документы с другим статусом не попадают в накопитель
+              if constexpr (IS_STATUS_PREDICATE<Predicate>) {
+                if (!IsAccepted(predicate, cursor.GetOrdinal())) {
+                  continue;
+                }
+              }
+              accumulator.Add(cursor.GetOrdinal() - begin,
+                cursor.GetTermFreq() * inverse_document_freq);
+            }
+        }
+
+        if (!is_complete) {
+          accumulator.Clear();
+          return;
         }
       }
+
+      auto &matched_documents = chunk_documents[chunk];
+      accumulator.Drain(
+        [this, begin, predicate, &minus_documents, &matched_documents](
+          int offset, double relevance) {
+          const int ordinal = begin + offset;
+          if (!minus_documents.Contains(ordinal)
+            && IsAccepted(predicate, ordinal)) {
+            matched_documents.emplace_back(
+              attributes_.GetId(ordinal),
+              relevance,
+              attributes_.GetRating(ordinal)
+            );
+          }
+        });
     }
   );
 
-  std::for_each(policy, query.minus_words.begin(), query.minus_words.end(),
-    [this, &document_to_relevance](std::string_view word) {
-      if (word_to_document_freqs_.count(word) == 0) {
-        return;
+  std::vector<Document> matched_documents;
+  for (auto &documents : chunk_documents) {
+    matched_documents.insert(matched_documents.end(),
+      documents.begin(), documents.end());
+  }
+  return matched_documents;
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindAllDocumentsShared(
+  ExecutionPolicy &&policy, const std::vector<const Query *> &queries,
+  DocumentStatus status) const {
+  PROFILE_SCOPE("FindAllDocumentsShared");
+
+  // Термы всех запросов без повторов; у каждого запроса - номера его
+  // термов в этом списке с IDF в порядке запроса, как в FindAllDocuments
+  std::vector<TermId> terms;
+  for (const Query *query : queries) {
+    for (const TermId term_id : query->plus_terms) {
+      if (!postings_[term_id].empty()) {
+        terms.push_back(term_id);
       }
-      for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-        document_to_relevance.Erase(document_id);
+    }
+  }
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+  std::vector<std::vector<std::pair<size_t, double>>> query_terms(
+    queries.size());
+  std::vector<MinusDocuments> minus_documents(queries.size());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    for (const TermId term_id : queries[i]->plus_terms) {
+      if (!postings_[term_id].empty()) {
+        query_terms[i].emplace_back(
+          std::lower_bound(terms.begin(), terms.end(), term_id)
+            - terms.begin(),
+          ComputeWordInverseDocumentFreq(term_id, queries[i]->statistics));
+      }
+    }
+    minus_documents[i] = CollectMinusDocuments(*queries[i]);
+  }
+
+  const DocumentStatusPredicate predicate{status};
+  const std::vector<uint64_t> &status_bitmap =
+    attributes_.GetStatusBitmap(status);
+
+  const int ordinal_count = static_cast<int>(documents_.size());
+  const int chunk_size = GetScoringChunkSize(
+    !std::is_same_v<std::decay_t<ExecutionPolicy>,
+      std::execution::sequenced_policy>);
+  const int chunk_count = (ordinal_count + chunk_size - 1) / chunk_size;
+
+  std::vector<int> chunks(chunk_count);
+  std::iota(chunks.begin(), chunks.end(), 0);
+  std::vector<std::vector<std::vector<Document>>> chunk_documents(
+    chunk_count, std::vector<std::vector<Document>>(queries.size()));
+
+  ForEach(ResolvePolicy(policy), chunks.begin(), chunks.end(),
+    [this, &terms, &query_terms, &minus_documents, &chunk_documents,
+      &status_bitmap, predicate, chunk_size, ordinal_count](int chunk) {
+      const int begin = chunk * chunk_size;
+      const int end = std::min(begin + chunk_size, ordinal_count);
+
+      // Вхождение терма: вклад в релевантность равен
+      // value * (step * inverse_document_freq), так же как при оценке
+      // одного запроса. У точных частот step равен 1
+      struct SharedPosting {
+        int offset;
+        double value;
+        double step;
+      };
+
+      // Вхождения термов в части диапазона с подходящим статусом;
+      // вхождения терма terms[i] - от term_ends[i - 1] до term_ends[i]
+      static thread_local std::vector<SharedPosting> shared_postings;
+      static thread_local std::vector<size_t> term_ends;
+      shared_postings.clear();
+      term_ends.clear();
+
+      const auto add_impacts = [begin, &status_bitmap](const int *ordinals,
+        const auto *impacts, size_t count, double step) {
+        for (size_t i = 0; i < count; ++i) {
+          if (DocumentAttributes::TestBit(status_bitmap, ordinals[i])) {
+            shared_postings.push_back({ordinals[i] - begin,
+              static_cast<double>(impacts[i]), step});
+          }
+        }
+        return true;
+      };
+
+      for (const TermId term_id : terms) {
+        const PostingList &postings = postings_[term_id];
+        switch (postings.GetImpactQuantization()) {
+          case ImpactQuantization::BITS_8:
+            postings.template ForEachImpactBlock<uint8_t>(begin, end,
+              add_impacts);
+            break;
+          case ImpactQuantization::BITS_16:
+            postings.template ForEachImpactBlock<uint16_t>(begin, end,
+              add_impacts);
+            break;
+          default:
+            PostingCursor cursor(postings);
+            for (cursor.AdvanceTo(begin); cursor.GetOrdinal() < end;
+              cursor.Next()) {
+              if (IsAccepted(predicate, cursor.GetOrdinal())) {
+                shared_postings.push_back({cursor.GetOrdinal() - begin,
+                  cursor.GetTermFreq(), 1.0});
+              }
+            }
+        }
+        term_ends.push_back(shared_postings.size());
+      }
+
+      static thread_local RelevanceAccumulator accumulator;
+      accumulator.Reset(end - begin);
+
+      for (size_t i = 0; i < query_terms.size(); ++i) {
+        for (const auto &[term_index, inverse_document_freq] :
+          query_terms[i]) {
+          const size_t first = term_index == 0 ? 0 : term_ends[term_index - 1];
+          for (size_t k = first; k < term_ends[term_index]; ++k) {
+            const SharedPosting &posting = shared_postings[k];
+            accumulator.Add(posting.offset,
+              posting.value * (posting.step * inverse_document_freq));
+          }
+        }
+
+        auto &matched_documents = chunk_documents[chunk][i];
+        accumulator.Drain(
+          [this, begin, predicate, &minus_documents = minus_documents[i],
+            &matched_documents](int offset, double relevance) {
+            const int ordinal = begin + offset;
+            if (!minus_documents.Contains(ordinal)
+              && IsAccepted(predicate, ordinal)) {
+              matched_documents.emplace_back(
+                attributes_.GetId(ordinal),
+                relevance,
+                attributes_.GetRating(ordinal)
+              );
+            }
+          });
       }
     }
   );
 
-  std::vector<Document> matched_documents;
-  for (const auto [document_id, relevance]
-    : document_to_relevance.BuildOrdinaryMap()) {
-    matched_documents.emplace_back(
-      document_id,
-      relevance,
-      documents_.at(document_id).rating
-    );
+  std::vector<std::vector<Document>> matched_documents(queries.size());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    for (auto &documents : chunk_documents) {
+      matched_documents[i].insert(matched_documents[i].end(),
+        documents[i].begin(), documents[i].end());
+    }
   }
   return matched_documents;
 }
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsPruned(
+  const Query& query, Predicate predicate) const {
+  PROFILE_SCOPE("score");
+
+  struct TermCursor {
+    PostingCursor cursor;
+    double inverse_document_freq;
+    double max_relevance;
+  };
+
+  // Курсоры плюс-слов в порядке запроса: в нём же суммируется релевантность,
+  // как и в FindAllDocuments
+  std::vector<TermCursor> terms;
+  for (const TermId term_id : query.plus_terms) {
+    const PostingList &postings = postings_[term_id];
+    if (postings.empty()) {
+      continue;
+    }
+    const double inverse_document_freq =
+      ComputeWordInverseDocumentFreq(term_id, query.statistics);
+    terms.push_back({
+      PostingCursor(postings),
+      inverse_document_freq,
+      postings.GetMaxTermFreq() * inverse_document_freq
+    });
+  }
+
+  const MinusDocuments minus_documents = CollectMinusDocuments(query);
+
+  // Релевантности MAX_RESULT_DOCUMENT_COUNT лучших принятых документов.
+  // Документ, уступающий худшей из них на EPSILON и более, после сортировки
+  // окажется ниже каждой из них, поэтому его можно не оценивать
+  std::priority_queue<double, std::vector<double>, std::greater<>> top;
+  const auto is_prunable = [&top](double relevance) {
+    return top.size() == MAX_RESULT_DOCUMENT_COUNT
+      && relevance < top.top() - EPSILON;
+  };
+
+  std::vector<Document> candidates;
+  std::vector<size_t> order(terms.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  // Документы оцениваются по возрастанию номера, поэтому при превышении
+  // ограничений кандидаты - точный результат для уже пройденных документов.
+  // Шаг цикла - оценка одного документа или пропуск блоков
+  for (size_t step = 0; ; ++step) {
+    if (step % PostingList::BLOCK_SIZE == 0 && query.IsExhausted()) {
+      break;
+    }
+
+    // Сдвигаются только первые курсоры, поэтому порядок почти отсортирован
+    // и сортировка вставками обходится дешевле std::sort
+    for (size_t i = 1; i < order.size(); ++i) {
+      const size_t index = order[i];
+      const int ordinal = terms[index].cursor.GetOrdinal();
+      size_t j = i;
+      for (; j > 0 && terms[order[j - 1]].cursor.GetOrdinal() > ordinal; --j) {
+        order[j] = order[j - 1];
+      }
+      order[j] = index;
+    }
+
+    // Опорный курсор: документы до него содержат только слова предыдущих
+    // курсоров, и суммы их максимальных вкладов недостаточно
+    size_t pivot = order.size();
+    double upper_bound = 0.0;
+    for (size_t i = 0; i < order.size(); ++i) {
+      const TermCursor &term = terms[order[i]];
+      if (term.cursor.GetOrdinal() == PostingCursor::END) {
+        break;
+      }
+      upper_bound += term.max_relevance;
+      if (!is_prunable(upper_bound)) {
+        pivot = i;
+        break;
+      }
+    }
+    if (pivot == order.size()) {
+      break;
+    }
+
+    const int pivot_ordinal = terms[order[pivot]].cursor.GetOrdinal();
+    size_t group_end = pivot + 1;
+    while (group_end < order.size()
+      && terms[order[group_end]].cursor.GetOrdinal() == pivot_ordinal) {
+      ++group_end;
+    }
+
+    // Уточнение границы по максимумам блоков, в которые попадает документ
+    double block_upper_bound = 0.0;
+    for (size_t i = 0; i < group_end; ++i) {
+      TermCursor &term = terms[order[i]];
+      term.cursor.AdvanceShallowTo(pivot_ordinal);
+      block_upper_bound += term.cursor.GetBlockMaxTermFreq(pivot_ordinal)
+        * term.inverse_document_freq;
+    }
+
+    if (is_prunable(block_upper_bound)) {
+      // Граница не меняется до конца текущих блоков или до следующего
+      // курсора, поэтому все документы до этого места пропускаются
+      int next_ordinal = group_end < order.size()
+        ? terms[order[group_end]].cursor.GetOrdinal()
+        : PostingCursor::END;
+      for (size_t i = 0; i < group_end; ++i) {
+        next_ordinal = std::min(next_ordinal,
+          terms[order[i]].cursor.GetBlockBoundary(pivot_ordinal));
+      }
+      for (size_t i = 0; i < group_end; ++i) {
+        terms[order[i]].cursor.AdvanceTo(next_ordinal);
+      }
+      continue;
+    }
+
+    if (terms[order[0]].cursor.GetOrdinal() != pivot_ordinal) {
+      for (size_t i = 0; i < pivot; ++i) {
+        terms[order[i]].cursor.AdvanceTo(pivot_ordinal);
+      }
+      continue;
+    }
+
+    // Документы с минус-словами и, при отборе по статусу, с другим
+    // статусом пропускаются до оценки
+    bool is_skipped = minus_documents.Contains(pivot_ordinal);
+    if constexpr (IS_STATUS_PREDICATE<Predicate>) {
+      is_skipped = is_skipped || !IsAccepted(predicate, pivot_ordinal);
+    }
+    if (is_skipped) {
+      for (size_t i = 0; i < group_end; ++i) {
+        terms[order[i]].cursor.Next();
+      }
+      continue;
+    }
+
+    std::sort(order.begin(), order.begin() + group_end);
+    double relevance = 0.0;
+    for (size_t i = 0; i < group_end; ++i) {
+      const TermCursor &term = terms[order[i]];
+      relevance += term.cursor.GetTermFreq() * term.inverse_document_freq;
+    }
+
+    for (size_t i = 0; i < group_end; ++i) {
+      terms[order[i]].cursor.Next();
+    }
+
+    if (is_prunable(relevance)) {
+      continue;
+    }
+
+    if (!IsAccepted(predicate, pivot_ordinal)) {
+      continue;
+    }
+
+    candidates.emplace_back(attributes_.GetId(pivot_ordinal), relevance,
+      attributes_.GetRating(pivot_ordinal));
+    top.push(relevance);
+    if (top.size() > MAX_RESULT_DOCUMENT_COUNT) {
+      top.pop();
+    }
+
+    if (candidates.size() >= 4 * MAX_RESULT_DOCUMENT_COUNT) {
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+        [&is_prunable](const Document &candidate) {
+          return is_prunable(candidate.relevance);
+        }), candidates.end());
+    }
+  }
+
+  candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+    [&is_prunable](const Document &candidate) {
+      return is_prunable(candidate.relevance);
+    }), candidates.end());
+
+  return candidates;
+}
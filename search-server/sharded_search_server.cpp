@@ -0,0 +1,54 @@
+#include "sharded_search_server.h"
+
+#include <mutex>
+
+void ShardedSearchServer::AddDocument(int document_id,
+  std::string_view document, DocumentStatus status,
+  const std::vector<int> &ratings) {
+  Shard &shard = GetShard(document_id);
+  std::unique_lock lock(shard.mutex);
+  shard.search_server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+  Shard &shard = GetShard(document_id);
+  std::unique_lock lock(shard.mutex);
+  shard.search_server.RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  std::string_view raw_query, DocumentStatus requested_status) const {
+  return FindTopDocuments(std::execution::seq, raw_query, requested_status);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  std::string_view raw_query) const {
+  return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+ShardedSearchServer::MatchDocument(std::string_view raw_query,
+  int document_id) const {
+  const Shard &shard = GetShard(document_id);
+  std::shared_lock lock(shard.mutex);
+  return shard.search_server.MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+  int document_count = 0;
+  for (const Shard &shard : shards_) {
+    std::shared_lock lock(shard.mutex);
+    document_count += shard.search_server.GetDocumentCount();
+  }
+  return document_count;
+}
+
+const ShardedSearchServer::Shard &ShardedSearchServer::GetShard(
+  int document_id) const {
+  // Отрицательный идентификатор отклонит сам шард
+  return shards_[document_id < 0 ? 0 : document_id % shards_.size()];
+}
+
+ShardedSearchServer::Shard &ShardedSearchServer::GetShard(int document_id) {
+  return shards_[document_id < 0 ? 0 : document_id % shards_.size()];
+}
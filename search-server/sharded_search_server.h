@@ -0,0 +1,156 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <deque>
+#include <execution>
+#include <numeric>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+/**
+ * Поисковый сервер, разделённый на шарды по идентификатору документа:
+ * документ с идентификатором id хранится в шарде id % shard_count.
+ *
+ * Запрос выполняется в два прохода по всем шардам: сначала собирается общая
+ * статистика (число документов и частоты слов запроса), затем каждый шард
+ * находит свои лучшие документы с IDF по общей статистике, и результаты
+ * сливаются в одном порядке с SearchServer. Поэтому релевантность совпадает
+ * с единым сервером с точностью до порядка сложения вкладов слов.
+ *
+ * У каждого шарда своя блокировка: добавления в разные шарды идут
+ * одновременно, запросы читают шарды под разделяемой блокировкой.
+ */
+class ShardedSearchServer {
+public:
+  template <typename StringContainer>
+  ShardedSearchServer(const StringContainer &stop_words, size_t shard_count);
+
+  void AddDocument(int document_id, std::string_view document,
+    DocumentStatus status, const std::vector<int> &ratings);
+
+  void RemoveDocument(int document_id);
+
+  // Политика задаёт обход шардов; внутри шарда поиск последовательный
+  template <typename ExecutionPolicy, typename Predicate>
+  std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, Predicate predicate) const;
+
+  template <typename ExecutionPolicy>
+  std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query, DocumentStatus requested_status) const;
+
+  template <typename ExecutionPolicy>
+  std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+    std::string_view raw_query) const;
+
+  template <typename Predicate>
+  std::vector<Document> FindTopDocuments(std::string_view raw_query,
+    Predicate predicate) const;
+
+  std::vector<Document> FindTopDocuments(std::string_view raw_query,
+    DocumentStatus requested_status) const;
+
+  std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+  // Выполняется шардом, которому принадлежит документ. Слова остаются
+  // действительными всё время жизни сервера
+  std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+    std::string_view raw_query, int document_id) const;
+
+  int GetDocumentCount() const;
+
+  [[nodiscard]] size_t GetShardCount() const {
+    return shards_.size();
+  }
+
+private:
+  struct Shard {
+    template <typename StringContainer>
+    explicit Shard(const StringContainer &stop_words)
+      : search_server(stop_words) {
+    }
+
+    SearchServer search_server;
+    mutable std::shared_mutex mutex;
+  };
+
+  std::deque<Shard> shards_;
+
+  const Shard &GetShard(int document_id) const;
+  Shard &GetShard(int document_id);
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer &stop_words,
+  size_t shard_count) {
+  using std::string_literals::operator""s;
+
+  if (shard_count == 0) {
+    throw std::invalid_argument("Shard count must be positive"s);
+  }
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards_.emplace_back(stop_words);
+  }
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  ExecutionPolicy &&policy, std::string_view raw_query,
+  Predicate predicate) const {
+  // Шарды блокируются на всё время запроса, чтобы статистика и поиск
+  // видели одни и те же документы
+  std::vector<std::shared_lock<std::shared_mutex>> locks;
+  locks.reserve(shards_.size());
+  for (const Shard &shard : shards_) {
+    locks.emplace_back(shard.mutex);
+  }
+
+  // Сбор статистики разбирает запрос и бросает те же исключения, что и
+  // SearchServer, до запуска параллельного алгоритма
+  CorpusStatistics statistics;
+  for (const Shard &shard : shards_) {
+    shard.search_server.CollectCorpusStatistics(raw_query, statistics);
+  }
+
+  std::vector<std::vector<Document>> shard_documents(shards_.size());
+  Transform(policy, shards_.begin(), shards_.end(),
+    shard_documents.begin(),
+    [raw_query, &predicate, &statistics](const Shard &shard) {
+      return shard.search_server.FindTopDocuments(std::execution::seq,
+        raw_query, predicate, statistics);
+    });
+
+  std::vector<Document> result;
+  for (const auto &documents : shard_documents) {
+    result.insert(result.end(), documents.begin(), documents.end());
+  }
+  SelectTopDocuments(result);
+  return result;
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  ExecutionPolicy &&policy, std::string_view raw_query,
+  DocumentStatus requested_status) const {
+  return FindTopDocuments(policy, raw_query,
+    DocumentStatusPredicate{requested_status});
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  ExecutionPolicy &&policy, std::string_view raw_query) const {
+  return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+  std::string_view raw_query, Predicate predicate) const {
+  return FindTopDocuments(std::execution::seq, raw_query, predicate);
+}
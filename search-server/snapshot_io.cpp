@@ -0,0 +1,153 @@
+#include "snapshot_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string_literals::operator""s;
+
+namespace {
+  const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+  const uint64_t FNV_PRIME = 1099511628211ull;
+
+  struct Header {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t byte_order_mark;
+    uint64_t payload_size;
+    uint64_t checksum;
+  };
+
+  uint64_t UpdateChecksum(uint64_t checksum, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      checksum ^= static_cast<unsigned char>(data[i]);
+      checksum *= FNV_PRIME;
+    }
+    return checksum;
+  }
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &path)
+  : out_(path, std::ios::binary | std::ios::trunc)
+  , checksum_(FNV_OFFSET_BASIS) {
+  if (!out_) {
+    throw std::runtime_error("Cannot create snapshot file "s + path);
+  }
+
+  // Заголовок перезаписывается в Finish
+  const Header header{};
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void SnapshotWriter::WriteString(std::string_view text) {
+  Write<uint64_t>(text.size());
+  WriteBytes(text.data(), text.size());
+}
+
+void SnapshotWriter::Finish() {
+  Header header{};
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.format_version = SNAPSHOT_FORMAT_VERSION;
+  header.byte_order_mark = BYTE_ORDER_MARK;
+  header.payload_size = size_;
+  header.checksum = checksum_;
+
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out_.flush();
+
+  if (!out_) {
+    throw std::runtime_error("Cannot write snapshot file"s);
+  }
+}
+
+void SnapshotWriter::WriteBytes(const void *data, size_t size) {
+  const auto *bytes = static_cast<const char *>(data);
+  out_.write(bytes, static_cast<std::streamsize>(size));
+  checksum_ = UpdateChecksum(checksum_, bytes, size);
+  size_ += size;
+}
+
+SnapshotReader::SnapshotReader(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open snapshot file "s + path);
+  }
+
+  struct stat file_stat{};
+  if (fstat(fd, &file_stat) != 0
+    || static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+    close(fd);
+    ThrowCorrupted();
+  }
+
+  mapping_size_ = static_cast<size_t>(file_stat.st_size);
+  void *mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Cannot map snapshot file "s + path);
+  }
+  mapping_ = static_cast<const char *>(mapping);
+
+  Header header{};
+  std::memcpy(&header, mapping_, sizeof(header));
+  position_ = mapping_ + sizeof(header);
+  end_ = mapping_ + mapping_size_;
+
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+    || header.byte_order_mark != BYTE_ORDER_MARK) {
+    munmap(const_cast<char *>(mapping_), mapping_size_);
+    throw std::runtime_error("Not a search server snapshot: "s + path);
+  }
+
+  if (header.format_version != SNAPSHOT_FORMAT_VERSION) {
+    munmap(const_cast<char *>(mapping_), mapping_size_);
+    throw std::runtime_error("Unsupported snapshot format version "s
+      + std::to_string(header.format_version));
+  }
+
+  if (header.payload_size != static_cast<uint64_t>(end_ - position_)
+    || UpdateChecksum(FNV_OFFSET_BASIS, position_, end_ - position_)
+      != header.checksum) {
+    munmap(const_cast<char *>(mapping_), mapping_size_);
+    ThrowCorrupted();
+  }
+
+  // Дальше данные читаются последовательно
+  madvise(const_cast<char *>(mapping_), mapping_size_, MADV_SEQUENTIAL);
+}
+
+SnapshotReader::~SnapshotReader() {
+  munmap(const_cast<char *>(mapping_), mapping_size_);
+}
+
+std::string_view SnapshotReader::ReadString() {
+  const auto size = Read<uint64_t>();
+  if (size > static_cast<uint64_t>(end_ - position_)) {
+    ThrowCorrupted();
+  }
+  return {Take(size), size};
+}
+
+void SnapshotReader::Finish() const {
+  if (position_ != end_) {
+    ThrowCorrupted();
+  }
+}
+
+const char *SnapshotReader::Take(size_t size) {
+  if (size > static_cast<size_t>(end_ - position_)) {
+    ThrowCorrupted();
+  }
+
+  const char *data = position_;
+  position_ += size;
+  return data;
+}
+
+void SnapshotReader::ThrowCorrupted() {
+  throw std::runtime_error("Snapshot file is corrupted"s);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Двоичный формат снимка индекса.
+ *
+ * Файл начинается с заголовка: сигнатура, версия формата, маркер порядка
+ * байтов, размер и контрольная сумма (FNV-1a, 64 бита) содержимого. Далее
+ * идут данные в порядке записи; массивы хранятся как размер и следом
+ * непрерывные элементы, поэтому читаются одним копированием.
+ */
+const uint32_t SNAPSHOT_FORMAT_VERSION = 4;
+
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(const std::string &path);
+
+  template <typename T>
+  void Write(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(&value, sizeof(value));
+  }
+
+  template <typename T>
+  void WriteArray(const std::vector<T> &values) {
+    static_assert(std::is_arithmetic_v<T>);
+    Write<uint64_t>(values.size());
+    WriteBytes(values.data(), values.size() * sizeof(T));
+  }
+
+  void WriteString(std::string_view text);
+
+  // Дописывает в заголовок размер и контрольную сумму содержимого
+  void Finish();
+
+private:
+  std::ofstream out_;
+  uint64_t size_ = 0;
+  uint64_t checksum_;
+
+  void WriteBytes(const void *data, size_t size);
+};
+
+/**
+ * Чтение снимка, отображённого в память (mmap). Конструктор проверяет
+ * заголовок и контрольную сумму; при любой ошибке бросается
+ * std::runtime_error.
+ */
+class SnapshotReader {
+public:
+  explicit SnapshotReader(const std::string &path);
+  ~SnapshotReader();
+
+  SnapshotReader(const SnapshotReader &) = delete;
+  SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+  template <typename T>
+  T Read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void ReadArray(std::vector<T> &values) {
+    static_assert(std::is_arithmetic_v<T>);
+    const auto size = Read<uint64_t>();
+    if (size > (end_ - position_) / sizeof(T)) {
+      ThrowCorrupted();
+    }
+    values.resize(size);
+    std::memcpy(values.data(), Take(size * sizeof(T)), size * sizeof(T));
+  }
+
+  // Строка указывает в отображённую память и действительна, пока жив
+  // объект чтения
+  std::string_view ReadString();
+
+  // Проверяет, что все данные снимка прочитаны
+  void Finish() const;
+
+private:
+  const char *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  const char *position_ = nullptr;
+  const char *end_ = nullptr;
+
+  const char *Take(size_t size);
+  [[noreturn]] static void ThrowCorrupted();
+};
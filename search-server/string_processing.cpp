@@ -1,23 +1,132 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
-  std::vector<std::string_view> result;
-  std::string_view word;
-  unsigned long pos = 0;
-
-  while (true) {
-    unsigned long space_pos = text.find(' ', pos);
-
-    if (space_pos == std::string::npos) {
-      word = text.substr(pos);
-      result.push_back(word);
-
-      break;
-    } else {
-      word = text.substr(pos, space_pos - pos);
-      pos = space_pos + 1;
-      result.push_back(word);
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_SERVER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool IsControlCharacter(char c) {
+  return static_cast<unsigned char>(c) < ' ';
+}
+
+// Побайтный разбор [pos, text.size()). word_begin - начало текущего слова
+void TokenizeScalar(std::string_view text, size_t pos, size_t word_begin,
+  TokenizedText &result) {
+  for (; pos < text.size(); ++pos) {
+    if (text[pos] == ' ') {
+      result.words.push_back(text.substr(word_begin, pos - word_begin));
+      word_begin = pos + 1;
+    } else if (IsControlCharacter(text[pos])) {
+      result.is_valid = false;
     }
   }
+  result.words.push_back(text.substr(word_begin));
+}
+
+#ifdef SEARCH_SERVER_X86_SIMD
+
+// Добавляет слова, заканчивающиеся на пробелах блока. Бит i маски
+// соответствует байту block_begin + i
+void EmitWords(std::string_view text, size_t block_begin, uint32_t space_mask,
+  size_t &word_begin, TokenizedText &result) {
+  while (space_mask != 0) {
+    const size_t pos = block_begin + __builtin_ctz(space_mask);
+    result.words.push_back(text.substr(word_begin, pos - word_begin));
+    word_begin = pos + 1;
+    space_mask &= space_mask - 1;
+  }
+}
+
+// Байт является управляющим символом, если min(байт, 0x1F) == байт
+void TokenizeSse2(std::string_view text, TokenizedText &result) {
+  const __m128i spaces = _mm_set1_epi8(' ');
+  const __m128i max_control = _mm_set1_epi8(' ' - 1);
+  __m128i controls = _mm_setzero_si128();
+
+  size_t pos = 0;
+  size_t word_begin = 0;
+  for (; pos + 16 <= text.size(); pos += 16) {
+    const __m128i block = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(text.data() + pos));
+    controls = _mm_or_si128(controls, _mm_cmpeq_epi8(
+      _mm_min_epu8(block, max_control), block));
+    const auto space_mask = static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(block, spaces)));
+    EmitWords(text, pos, space_mask, word_begin, result);
+  }
+
+  if (_mm_movemask_epi8(controls) != 0) {
+    result.is_valid = false;
+  }
+  TokenizeScalar(text, pos, word_begin, result);
+}
+
+__attribute__((target("avx2")))
+void TokenizeAvx2(std::string_view text, TokenizedText &result) {
+  const __m256i spaces = _mm256_set1_epi8(' ');
+  const __m256i max_control = _mm256_set1_epi8(' ' - 1);
+  __m256i controls = _mm256_setzero_si256();
+
+  size_t pos = 0;
+  size_t word_begin = 0;
+  for (; pos + 32 <= text.size(); pos += 32) {
+    const __m256i block = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(text.data() + pos));
+    controls = _mm256_or_si256(controls, _mm256_cmpeq_epi8(
+      _mm256_min_epu8(block, max_control), block));
+    const auto space_mask = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, spaces)));
+    EmitWords(text, pos, space_mask, word_begin, result);
+  }
+
+  if (_mm256_movemask_epi8(controls) != 0) {
+    result.is_valid = false;
+  }
+  TokenizeScalar(text, pos, word_begin, result);
+}
+
+#endif
+
+using TokenizeFunction = void (*)(std::string_view, TokenizedText &);
+
+TokenizeFunction SelectTokenizeFunction() {
+#ifdef SEARCH_SERVER_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return TokenizeAvx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return TokenizeSse2;
+  }
+#endif
+  return [](std::string_view text, TokenizedText &result) {
+    TokenizeScalar(text, 0, 0, result);
+  };
+}
+
+}  // namespace
+
+TokenizedText Tokenize(const std::string_view text) {
+  static const TokenizeFunction tokenize = SelectTokenizeFunction();
+
+  TokenizedText result;
+  tokenize(text, result);
   return result;
 }
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
+  return Tokenize(text).words;
+}
+
+bool HasControlCharacters(const std::string_view text) {
+  for (const char c : text) {
+    if (IsControlCharacter(c)) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -2,10 +2,30 @@
 
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Слова текста вместе с результатом проверки символов
+struct TokenizedText {
+  std::vector<std::string_view> words;
+  // В тексте нет управляющих символов (коды 0x00-0x1F)
+  bool is_valid = true;
+};
+
+/**
+ * Разбивает текст по пробелам и проверяет символы за один проход.
+ * Пустые слова (между соседними пробелами, в начале и в конце текста)
+ * сохраняются, как и в SplitIntoWords. На x86 текст просматривается блоками
+ * по 16 или 32 байта (SSE2 или AVX2, выбирается при запуске), на остальных
+ * платформах - побайтно
+ */
+TokenizedText Tokenize(std::string_view text);
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Содержит ли текст управляющие символы (коды 0x00-0x1F)
+bool HasControlCharacters(std::string_view text);
+
 // Возвращает множество уникальных НЕ пустых строк
 template <typename StringContainer>
 std::set<std::string> MakeUniqueNonEmptyStrings(
@@ -0,0 +1,103 @@
+#include "term_dictionary.h"
+
+#include <functional>
+#include <stdexcept>
+
+TermId TermDictionary::Intern(std::string_view term) {
+  if ((terms_.size() + 1) * 2 > slots_.size()) {
+    Rehash(slots_.empty() ? 16 : slots_.size() * 2);
+  }
+
+  const size_t hash = Hash(term);
+  Slot &slot = slots_[FindSlot(term, hash)];
+
+  if (slot.term_id == NO_TERM) {
+    slot.hash = hash;
+    slot.term_id = static_cast<TermId>(terms_.size());
+    terms_.emplace_back(term);
+  }
+
+  return slot.term_id;
+}
+
+TermId TermDictionary::Find(std::string_view term) const {
+  if (slots_.empty()) {
+    return NO_TERM;
+  }
+
+  return slots_[FindSlot(term, Hash(term))].term_id;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+  size_t bytes = slots_.capacity() * sizeof(Slot);
+  for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+    bytes += GetTermMemoryUsage(term_id);
+  }
+  return bytes;
+}
+
+size_t TermDictionary::GetTermMemoryUsage(TermId term_id) const {
+  const std::string &term = terms_[term_id];
+  // Короткие строки хранятся внутри объекта std::string
+  const auto *object = reinterpret_cast<const char*>(&term);
+  const bool is_inline = term.data() >= object
+    && term.data() < object + sizeof(std::string);
+  return sizeof(std::string) + (is_inline ? 0 : term.capacity() + 1);
+}
+
+void TermDictionary::Save(SnapshotWriter &writer) const {
+  writer.Write<uint64_t>(terms_.size());
+  for (const std::string &term : terms_) {
+    writer.WriteString(term);
+  }
+}
+
+TermDictionary TermDictionary::Load(SnapshotReader &reader) {
+  TermDictionary dictionary;
+  const auto term_count = reader.Read<uint64_t>();
+
+  for (uint64_t i = 0; i < term_count; ++i) {
+    dictionary.Intern(reader.ReadString());
+  }
+
+  // Повторяющийся терм сдвинул бы идентификаторы
+  if (dictionary.size() != term_count) {
+    throw std::runtime_error("Snapshot file is corrupted");
+  }
+
+  return dictionary;
+}
+
+size_t TermDictionary::Hash(std::string_view term) {
+  return std::hash<std::string_view>{}(term);
+}
+
+size_t TermDictionary::FindSlot(std::string_view term, size_t hash) const {
+  const size_t mask = slots_.size() - 1;
+
+  for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+    const Slot &slot = slots_[index];
+    if (slot.term_id == NO_TERM
+      || (slot.hash == hash && terms_[slot.term_id] == term)) {
+      return index;
+    }
+  }
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+  std::vector<Slot> old_slots(slot_count);
+  std::swap(slots_, old_slots);
+
+  const size_t mask = slots_.size() - 1;
+  for (const Slot &slot : old_slots) {
+    if (slot.term_id == NO_TERM) {
+      continue;
+    }
+
+    size_t index = slot.hash & mask;
+    while (slots_[index].term_id != NO_TERM) {
+      index = (index + 1) & mask;
+    }
+    slots_[index] = slot;
+  }
+}
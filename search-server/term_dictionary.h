@@ -0,0 +1,66 @@
+#pragma once
+
+#include "snapshot_io.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+/**
+ * Словарь термов: каждому терму при первом добавлении выдаётся плотный
+ * целочисленный идентификатор. Поиск идёт по хеш-таблице с открытой
+ * адресацией (линейное пробирование) и принимает std::string_view без
+ * создания временных строк.
+ *
+ * Идентификаторы не переиспользуются, тексты термов хранятся в самом словаре
+ * и не перемещаются, поэтому std::string_view, полученные из GetTerm,
+ * действительны всё время жизни словаря.
+ */
+class TermDictionary {
+public:
+  static const TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+  // Возвращает идентификатор терма, добавляя терм в словарь при отсутствии
+  TermId Intern(std::string_view term);
+
+  // Возвращает идентификатор терма или NO_TERM, если терма нет в словаре
+  [[nodiscard]] TermId Find(std::string_view term) const;
+
+  [[nodiscard]] std::string_view GetTerm(TermId term_id) const {
+    return terms_[term_id];
+  }
+
+  [[nodiscard]] size_t size() const {
+    return terms_.size();
+  }
+
+  // Память, занятая хеш-таблицей и текстами термов
+  [[nodiscard]] size_t GetMemoryUsage() const;
+  // Память, занятая текстом одного терма
+  [[nodiscard]] size_t GetTermMemoryUsage(TermId term_id) const;
+
+  // Сохраняются только тексты термов по порядку идентификаторов; хеш-таблица
+  // при загрузке строится заново
+  void Save(SnapshotWriter &writer) const;
+  static TermDictionary Load(SnapshotReader &reader);
+
+private:
+  struct Slot {
+    size_t hash = 0;
+    TermId term_id = NO_TERM;
+  };
+
+  // Размер таблицы всегда степень двойки, заполненность не выше половины
+  std::vector<Slot> slots_;
+  std::deque<std::string> terms_;
+
+  static size_t Hash(std::string_view term);
+  [[nodiscard]] size_t FindSlot(std::string_view term, size_t hash) const;
+  void Rehash(size_t slot_count);
+};
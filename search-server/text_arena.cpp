@@ -0,0 +1,32 @@
+#include "text_arena.h"
+
+#include <algorithm>
+
+TextArena::Handle TextArena::Add(std::string_view text) {
+  // Текст больше блока получает собственный блок
+  if (chunks_.empty()
+    || chunks_.back().size() + text.size() > chunks_.back().capacity()) {
+    chunks_.emplace_back();
+    chunks_.back().reserve(std::max(CHUNK_SIZE, text.size()));
+  }
+
+  std::string &chunk = chunks_.back();
+  const Handle handle{
+    static_cast<uint32_t>(chunks_.size() - 1),
+    static_cast<uint32_t>(chunk.size()),
+    static_cast<uint32_t>(text.size())
+  };
+
+  chunk.append(text);
+  live_bytes_ += text.size();
+
+  return handle;
+}
+
+size_t TextArena::GetCapacity() const {
+  size_t capacity = 0;
+  for (const std::string &chunk : chunks_) {
+    capacity += chunk.capacity();
+  }
+  return capacity;
+}
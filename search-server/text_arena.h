@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Хранилище текстов документов: тексты дописываются подряд в крупные
+ * блоки фиксированной ёмкости вместо отдельного выделения памяти на каждый
+ * документ. Текст адресуется дескриптором (номер блока и смещение), поэтому
+ * хранилище можно копировать и пересобирать, не оставляя висячих ссылок.
+ *
+ * Освобождённые тексты только учитываются; память возвращается при
+ * пересборке хранилища (SearchServer::Compact).
+ */
+class TextArena {
+public:
+  static const size_t CHUNK_SIZE = 1 << 20;
+
+  struct Handle {
+    uint32_t chunk = 0;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+  };
+
+  Handle Add(std::string_view text);
+
+  [[nodiscard]] std::string_view Get(Handle handle) const {
+    return std::string_view(chunks_[handle.chunk]).substr(handle.offset,
+      handle.size);
+  }
+
+  // Отмечает текст как неиспользуемый
+  void Release(Handle handle) {
+    live_bytes_ -= handle.size;
+  }
+
+  // Суммарный размер используемых текстов
+  [[nodiscard]] size_t GetLiveBytes() const {
+    return live_bytes_;
+  }
+
+  // Память, занятая блоками
+  [[nodiscard]] size_t GetCapacity() const;
+
+private:
+  std::vector<std::string> chunks_;
+  size_t live_bytes_ = 0;
+};
@@ -0,0 +1,217 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Пул, которому принадлежит текущий поток, и номер потока в нём
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+// Глубина вложенности выполняемых задач в текущем потоке
+thread_local size_t task_depth = 0;
+
+int64_t GetNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t thread_count)
+  : stats_start_ns_(GetNowNs()) {
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_.emplace_back();
+  }
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this, i] {
+      WorkerLoop(i);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_up_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::GetStats() const {
+  const double elapsed_ns = static_cast<double>(
+    std::max<int64_t>(GetNowNs() - stats_start_ns_.load(), 1));
+
+  std::vector<WorkerStats> result;
+  result.reserve(workers_.size());
+  for (const Worker &worker : workers_) {
+    WorkerStats stats;
+    stats.task_count = worker.task_count.load();
+    stats.steal_count = worker.steal_count.load();
+    stats.busy_ns = worker.busy_ns.load();
+    stats.utilization = std::min(1.0, stats.busy_ns / elapsed_ns);
+    result.push_back(stats);
+  }
+  return result;
+}
+
+void ThreadPool::ResetStats() {
+  for (Worker &worker : workers_) {
+    worker.task_count = 0;
+    worker.steal_count = 0;
+    worker.busy_ns = 0;
+  }
+  stats_start_ns_ = GetNowNs();
+}
+
+size_t ThreadPool::GetCurrentWorker() const {
+  return current_pool == this ? current_worker : workers_.size();
+}
+
+void ThreadPool::WorkerLoop(size_t worker) {
+  current_pool = this;
+  current_worker = worker;
+
+  while (true) {
+    if (RunTask(worker)) {
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex_);
+    wake_up_.wait(lock, [this] {
+      return stop_ || queued_task_count_.load() > 0;
+    });
+    if (stop_) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::Submit(RunFunction run, const void *context,
+  size_t task_count, TaskGroup &group) {
+  group.pending = task_count;
+  // Счётчик увеличивается до того, как задачи станут доступны, чтобы
+  // взявший задачу поток не опередил его
+  queued_task_count_ += task_count;
+
+  const size_t worker = GetCurrentWorker();
+  if (worker < workers_.size()) {
+    // Задачи потока пула остаются в его очереди: он выполняет их сам, пока
+    // их не заберут свободные потоки
+    std::lock_guard lock(workers_[worker].mutex);
+    for (size_t task = 0; task < task_count; ++task) {
+      workers_[worker].tasks.push_back({run, context, task, &group});
+    }
+  } else {
+    const size_t first_worker = next_worker_.fetch_add(task_count);
+    for (size_t task = 0; task < task_count; ++task) {
+      Worker &target = workers_[(first_worker + task) % workers_.size()];
+      std::lock_guard lock(target.mutex);
+      target.tasks.push_back({run, context, task, &group});
+    }
+  }
+
+  // Поток, проверивший счётчик до увеличения, к этому моменту уже ждёт
+  // сигнала и не пропустит его
+  {
+    std::lock_guard lock(sleep_mutex_);
+  }
+  wake_up_.notify_all();
+}
+
+void ThreadPool::Wait(TaskGroup &group) {
+  const size_t worker = GetCurrentWorker();
+  while (group.pending.load() > 0) {
+    if (RunTask(worker)) {
+      continue;
+    }
+
+    if (worker < workers_.size()) {
+      // Оставшиеся задачи группы выполняются другими потоками, но они могут
+      // породить вложенные задачи, которые стоит забрать
+      std::this_thread::yield();
+    } else {
+      std::unique_lock lock(group.mutex);
+      group.done.wait(lock, [&group] {
+        return group.pending.load() == 0;
+      });
+    }
+  }
+
+  // Последняя задача уменьшает счётчик под блокировкой; после её снятия
+  // группу можно уничтожать
+  std::lock_guard lock(group.mutex);
+  if (group.error) {
+    std::rethrow_exception(group.error);
+  }
+}
+
+bool ThreadPool::RunTask(size_t worker) {
+  Task task;
+  bool is_found = false;
+  bool is_stolen = false;
+
+  if (worker < workers_.size()) {
+    Worker &own = workers_[worker];
+    std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      is_found = true;
+    }
+  }
+
+  for (size_t offset = 1; !is_found && offset <= workers_.size(); ++offset) {
+    Worker &victim = workers_[(worker + offset) % workers_.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      is_found = true;
+      is_stolen = worker < workers_.size();
+    }
+  }
+
+  if (!is_found) {
+    return false;
+  }
+
+  --queued_task_count_;
+  Execute(task, worker, is_stolen);
+  return true;
+}
+
+void ThreadPool::Execute(const Task &task, size_t worker, bool is_stolen) {
+  const bool is_measured = worker < workers_.size() && task_depth == 0;
+  const int64_t start_ns = is_measured ? GetNowNs() : 0;
+
+  ++task_depth;
+  std::exception_ptr error;
+  try {
+    task.run(task.context, task.index);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  --task_depth;
+
+  if (worker < workers_.size()) {
+    Worker &stats = workers_[worker];
+    ++stats.task_count;
+    if (is_stolen) {
+      ++stats.steal_count;
+    }
+    if (is_measured) {
+      stats.busy_ns += static_cast<uint64_t>(GetNowNs() - start_ns);
+    }
+  }
+
+  TaskGroup &group = *task.group;
+  std::lock_guard lock(group.mutex);
+  if (error && !group.error) {
+    group.error = error;
+  }
+  if (--group.pending == 0) {
+    group.done.notify_all();
+  }
+}
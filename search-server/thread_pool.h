@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Число задач на поток, на которые ParallelFor делит диапазон, чтобы
+// выровнять нагрузку между потоками
+const size_t THREAD_POOL_TASKS_PER_THREAD = 4;
+// Меньшие части Sort на пуле сортируются последовательно
+const size_t THREAD_POOL_MIN_SORT_PART_SIZE = 4096;
+
+/**
+ * Пул потоков с захватом работы (work stealing). У каждого потока своя
+ * очередь задач: поток берёт задачи с её конца, а освободившиеся потоки
+ * забирают задачи с начала чужих очередей.
+ *
+ * Поток, вызвавший ParallelFor, не простаивает до завершения задач, а
+ * выполняет их сам, в том числе чужие. Поэтому вложенные вызовы (задача
+ * пула сама вызывает ParallelFor) не создают новых потоков и не блокируют
+ * существующие: одновременно работают не больше потоков, чем в пуле, плюс
+ * внешние вызывающие.
+ *
+ * Исключение, брошенное задачей, не завершает программу, как в
+ * стандартных параллельных алгоритмах, а бросается из ParallelFor после
+ * завершения остальных задач.
+ */
+class ThreadPool {
+public:
+  struct WorkerStats {
+    // Выполнено задач, включая вложенные
+    uint64_t task_count = 0;
+    // Из них взято из очередей других потоков
+    uint64_t steal_count = 0;
+    // Время выполнения задач верхнего уровня (вложенные задачи и ожидание
+    // их завершения входят во время охватывающей задачи)
+    uint64_t busy_ns = 0;
+    // Доля времени с момента создания пула или ResetStats, занятая задачами
+    double utilization = 0.0;
+  };
+
+  // thread_count == 0: все задачи выполняются вызывающим потоком
+  explicit ThreadPool(size_t thread_count = std::max(1u,
+    std::thread::hardware_concurrency()));
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Вызовы ParallelFor к этому моменту должны быть завершены
+  ~ThreadPool();
+
+  [[nodiscard]] size_t GetThreadCount() const {
+    return threads_.size();
+  }
+
+  // Вызывает func(i) для всех i из [0, count) и возвращается, когда все
+  // вызовы завершены. Соседние индексы объединяются в задачи
+  template <typename Function>
+  void ParallelFor(size_t count, Function func);
+
+  // Статистика по потокам пула; работа внешних потоков, помогающих пулу
+  // внутри ParallelFor, в неё не входит
+  [[nodiscard]] std::vector<WorkerStats> GetStats() const;
+
+  void ResetStats();
+
+private:
+  using RunFunction = void (*)(const void *context, size_t task);
+
+  // Задачи одного вызова ParallelFor
+  struct TaskGroup {
+    std::atomic<size_t> pending = 0;
+    // Защищает pending при уменьшении и error
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+  };
+
+  struct Task {
+    RunFunction run;
+    const void *context;
+    size_t index;
+    TaskGroup *group;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::atomic<uint64_t> task_count = 0;
+    std::atomic<uint64_t> steal_count = 0;
+    std::atomic<uint64_t> busy_ns = 0;
+  };
+
+  std::deque<Worker> workers_;
+  std::vector<std::thread> threads_;
+  // Число задач во всех очередях; потоки засыпают, когда оно равно нулю
+  std::atomic<size_t> queued_task_count_ = 0;
+  // Очередь, в которую внешний поток положит следующую задачу
+  std::atomic<size_t> next_worker_ = 0;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_up_;
+  bool stop_ = false;
+  std::atomic<int64_t> stats_start_ns_ = 0;
+
+  // Номер текущего потока в пуле или GetThreadCount() для внешнего потока
+  size_t GetCurrentWorker() const;
+  void WorkerLoop(size_t worker);
+  void Submit(RunFunction run, const void *context, size_t task_count,
+    TaskGroup &group);
+  // Выполняет задачи, пока не завершится группа; бросает исключение задачи
+  void Wait(TaskGroup &group);
+  // Берёт задачу из своей очереди или из чужой и выполняет её
+  bool RunTask(size_t worker);
+  void Execute(const Task &task, size_t worker, bool is_stolen);
+};
+
+/**
+ * Политика выполнения на пуле потоков. Принимается шаблонными методами
+ * SearchServer наравне со стандартными политиками; алгоритмы ниже
+ * (ForEach, Transform, Sort, StableSort) выполняют её задачами пула.
+ * Политика без пула равносильна std::execution::par.
+ */
+class ThreadPoolPolicy {
+public:
+  ThreadPoolPolicy() = default;
+
+  explicit ThreadPoolPolicy(ThreadPool &pool)
+    : pool_(&pool) {
+  }
+
+  [[nodiscard]] ThreadPool *GetPool() const {
+    return pool_;
+  }
+
+private:
+  ThreadPool *pool_ = nullptr;
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function func) {
+  if (count == 0) {
+    return;
+  }
+
+  const size_t task_count = std::min(count,
+    threads_.size() * THREAD_POOL_TASKS_PER_THREAD);
+  if (task_count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  struct Context {
+    const Function *func;
+    size_t count;
+    size_t task_count;
+  };
+  const Context context{&func, count, task_count};
+
+  TaskGroup group;
+  Submit([](const void *data, size_t task) {
+      const Context &context = *static_cast<const Context *>(data);
+      const size_t begin = task * context.count / context.task_count;
+      const size_t end = (task + 1) * context.count / context.task_count;
+      for (size_t i = begin; i < end; ++i) {
+        (*context.func)(i);
+      }
+    }, &context, task_count, group);
+  Wait(group);
+}
+
+template <typename ExecutionPolicy>
+inline constexpr bool IS_THREAD_POOL_POLICY =
+  std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPoolPolicy>;
+
+// std::for_each с политикой выполнения, в том числе ThreadPoolPolicy
+template <typename ExecutionPolicy, typename RandomIt, typename Function>
+void ForEach(ExecutionPolicy &&policy, RandomIt first, RandomIt last,
+  Function func) {
+  if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+    ThreadPool *const pool = policy.GetPool();
+    if (pool == nullptr) {
+      std::for_each(std::execution::par, first, last, func);
+      return;
+    }
+    pool->ParallelFor(static_cast<size_t>(last - first),
+      [first, &func](size_t i) {
+        func(first[i]);
+      });
+  } else {
+    std::for_each(policy, first, last, func);
+  }
+}
+
+// std::transform с политикой выполнения, в том числе ThreadPoolPolicy
+template <typename ExecutionPolicy, typename RandomIt, typename OutputIt,
+  typename Function>
+OutputIt Transform(ExecutionPolicy &&policy, RandomIt first, RandomIt last,
+  OutputIt result, Function func) {
+  if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+    ThreadPool *const pool = policy.GetPool();
+    if (pool == nullptr) {
+      return std::transform(std::execution::par, first, last, result, func);
+    }
+    const size_t count = static_cast<size_t>(last - first);
+    pool->ParallelFor(count, [first, result, &func](size_t i) {
+      result[i] = func(first[i]);
+    });
+    return result + count;
+  } else {
+    return std::transform(policy, first, last, result, func);
+  }
+}
+
+// Части диапазона сортируются задачами пула, затем сливаются попарно.
+// std::inplace_merge устойчиво, поэтому при устойчивой сортировке частей
+// устойчива и вся сортировка
+template <typename RandomIt, typename Compare>
+void SortOnPool(ThreadPool &pool, RandomIt first, RandomIt last,
+  Compare comp, bool is_stable) {
+  const size_t size = static_cast<size_t>(last - first);
+  const size_t part_count = std::min(pool.GetThreadCount(),
+    size / THREAD_POOL_MIN_SORT_PART_SIZE);
+  if (part_count <= 1) {
+    if (is_stable) {
+      std::stable_sort(first, last, comp);
+    } else {
+      std::sort(first, last, comp);
+    }
+    return;
+  }
+
+  std::vector<size_t> bounds(part_count + 1);
+  for (size_t part = 0; part <= part_count; ++part) {
+    bounds[part] = part * size / part_count;
+  }
+
+  pool.ParallelFor(part_count, [first, &bounds, &comp, is_stable](
+    size_t part) {
+    if (is_stable) {
+      std::stable_sort(first + bounds[part], first + bounds[part + 1], comp);
+    } else {
+      std::sort(first + bounds[part], first + bounds[part + 1], comp);
+    }
+  });
+
+  for (size_t width = 1; width < part_count; width *= 2) {
+    const size_t pair_count = (part_count + 2 * width - 1) / (2 * width);
+    pool.ParallelFor(pair_count, [first, &bounds, &comp, width, part_count](
+      size_t pair) {
+      const size_t begin = pair * 2 * width;
+      const size_t middle = std::min(begin + width, part_count);
+      const size_t end = std::min(begin + 2 * width, part_count);
+      if (middle < end) {
+        std::inplace_merge(first + bounds[begin], first + bounds[middle],
+          first + bounds[end], comp);
+      }
+    });
+  }
+}
+
+// std::sort с политикой выполнения, в том числе ThreadPoolPolicy
+template <typename ExecutionPolicy, typename RandomIt,
+  typename Compare = std::less<>>
+void Sort(ExecutionPolicy &&policy, RandomIt first, RandomIt last,
+  Compare comp = Compare()) {
+  if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+    ThreadPool *const pool = policy.GetPool();
+    if (pool == nullptr) {
+      std::sort(std::execution::par, first, last, comp);
+    } else {
+      SortOnPool(*pool, first, last, comp, false);
+    }
+  } else {
+    std::sort(policy, first, last, comp);
+  }
+}
+
+// std::stable_sort с политикой выполнения, в том числе ThreadPoolPolicy
+template <typename ExecutionPolicy, typename RandomIt,
+  typename Compare = std::less<>>
+void StableSort(ExecutionPolicy &&policy, RandomIt first, RandomIt last,
+  Compare comp = Compare()) {
+  if constexpr (IS_THREAD_POOL_POLICY<ExecutionPolicy>) {
+    ThreadPool *const pool = policy.GetPool();
+    if (pool == nullptr) {
+      std::stable_sort(std::execution::par, first, last, comp);
+    } else {
+      SortOnPool(*pool, first, last, comp, true);
+    }
+  } else {
+    std::stable_sort(policy, first, last, comp);
+  }
+}
@@ -0,0 +1,73 @@
+#include "versioned_search_server.h"
+
+VersionedSearchServer::Snapshot VersionedSearchServer::Pin() const {
+  while (true) {
+    const int active = active_.load();
+    const Instance &instance = instances_[active];
+    instance.readers.fetch_add(1);
+
+    // Если писатель успел переключить версию до регистрации читателя,
+    // он мог уже не дождаться его; пробуем снова
+    if (active_.load() == active) {
+      return Snapshot(instance.search_server, instance.readers,
+        instance.version);
+    }
+
+    instance.readers.fetch_sub(1);
+  }
+}
+
+void VersionedSearchServer::AddDocument(int document_id,
+  std::string_view document, DocumentStatus status,
+  const std::vector<int> &ratings) {
+  Write([document_id, document, status, &ratings](
+    SearchServer &search_server) {
+    search_server.AddDocument(document_id, document, status, ratings);
+  });
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id) {
+  Write([document_id](SearchServer &search_server) {
+    search_server.RemoveDocument(document_id);
+  });
+}
+
+void VersionedSearchServer::Compact() {
+  Write([](SearchServer &search_server) {
+    search_server.Compact();
+  });
+}
+
+void VersionedSearchServer::SetQueryEvaluation(
+  QueryEvaluation query_evaluation) {
+  Write([query_evaluation](SearchServer &search_server) {
+    search_server.SetQueryEvaluation(query_evaluation);
+  });
+}
+
+void VersionedSearchServer::SetQueryCacheCapacity(size_t capacity) {
+  Write([capacity](SearchServer &search_server) {
+    search_server.SetQueryCacheCapacity(capacity);
+  });
+}
+
+void VersionedSearchServer::SetThreadPool(
+  std::shared_ptr<ThreadPool> thread_pool) {
+  Write([&thread_pool](SearchServer &search_server) {
+    search_server.SetThreadPool(thread_pool);
+  });
+}
+
+QueryCache::Stats VersionedSearchServer::GetQueryCacheStats() const {
+  QueryCache::Stats result;
+  for (const Instance &instance : instances_) {
+    const QueryCache::Stats stats = instance.search_server.GetQueryCacheStats();
+    result.hits += stats.hits;
+    result.misses += stats.misses;
+  }
+  return result;
+}
+
+int VersionedSearchServer::GetDocumentCount() const {
+  return Pin()->GetDocumentCount();
+}
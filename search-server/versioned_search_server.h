@@ -0,0 +1,167 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Поисковый сервер, допускающий запросы одновременно с добавлением и
+ * удалением документов.
+ *
+ * Внутри хранятся две копии индекса (схема left-right). Читатели закрепляют
+ * активную копию (Pin) и работают с ней без блокировок. Писатель, защищённый
+ * мьютексом, применяет изменение к неактивной копии, атомарно делает её
+ * активной, дожидается ухода читателей со старой копии и повторяет на ней то
+ * же изменение. Читатель никогда не видит наполовину добавленный документ,
+ * а старая версия переиспользуется, как только её перестают читать.
+ *
+ * Читатели не блокируются; писатель ждёт, пока освободятся снимки старой
+ * версии, поэтому снимки не стоит держать дольше одного запроса.
+ */
+class VersionedSearchServer {
+public:
+  // Закреплённая версия индекса. Пока снимок существует, видимая через
+  // него копия индекса не изменяется
+  class Snapshot {
+  public:
+    Snapshot(Snapshot &&other) noexcept
+      : search_server_(other.search_server_)
+      , readers_(std::exchange(other.readers_, nullptr))
+      , version_(other.version_) {
+    }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    Snapshot &operator=(Snapshot &&) = delete;
+
+    ~Snapshot() {
+      if (readers_ != nullptr) {
+        readers_->fetch_sub(1);
+      }
+    }
+
+    const SearchServer &operator*() const {
+      return *search_server_;
+    }
+
+    const SearchServer *operator->() const {
+      return search_server_;
+    }
+
+    // Число изменений индекса, видимых в этом снимке
+    [[nodiscard]] uint64_t GetVersion() const {
+      return version_;
+    }
+
+  private:
+    friend class VersionedSearchServer;
+
+    Snapshot(const SearchServer &search_server, std::atomic<int> &readers,
+      uint64_t version)
+      : search_server_(&search_server)
+      , readers_(&readers)
+      , version_(version) {
+    }
+
+    const SearchServer *search_server_;
+    std::atomic<int> *readers_;
+    uint64_t version_;
+  };
+
+  template <typename StringContainer>
+  explicit VersionedSearchServer(const StringContainer &stop_words)
+    : instances_{{
+      {SearchServer(stop_words), {0}, 0},
+      {SearchServer(stop_words), {0}, 0}
+    }} {
+  }
+
+  // Закрепляет текущую версию индекса. Не блокируется
+  [[nodiscard]] Snapshot Pin() const;
+
+  void AddDocument(int document_id, std::string_view document,
+    DocumentStatus status, const std::vector<int> &ratings);
+
+  void RemoveDocument(int document_id);
+
+  // Уплотнение выполняется на неактивной копии и не задерживает читателей
+  void Compact();
+
+  void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+  // Каждая копия индекса держит свой кеш; счётчики суммируются
+  void SetQueryCacheCapacity(size_t capacity);
+
+  [[nodiscard]] QueryCache::Stats GetQueryCacheStats() const;
+
+  // Обе копии индекса выполняют параллельные алгоритмы на одном пуле
+  void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool);
+
+  // Запросы выполняются на закреплённой на время вызова версии. Слова,
+  // возвращаемые MatchDocument, остаются действительными всё время жизни
+  // сервера. Перегрузки с QueryLimits возвращают SearchResult
+  template <typename... Args>
+  decltype(auto) FindTopDocuments(Args &&...args) const {
+    const Snapshot snapshot = Pin();
+    return snapshot->FindTopDocuments(std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::tuple<std::vector<std::string_view>, DocumentStatus>
+  MatchDocument(Args &&...args) const {
+    const Snapshot snapshot = Pin();
+    return snapshot->MatchDocument(std::forward<Args>(args)...);
+  }
+
+  int GetDocumentCount() const;
+
+private:
+  struct Instance {
+    SearchServer search_server;
+    // Число читателей, закрепивших эту копию
+    mutable std::atomic<int> readers;
+    // Число изменений, применённых к копии
+    uint64_t version;
+  };
+
+  std::array<Instance, 2> instances_;
+  std::atomic<int> active_{0};
+  std::mutex write_mutex_;
+
+  // Применяет func(SearchServer&) к обеим копиям так, чтобы читатели
+  // видели либо старую, либо новую версию целиком. Если изменение бросает
+  // исключение на неактивной копии, индекс не меняется
+  template <typename Function>
+  void Write(Function func);
+};
+
+template <typename Function>
+void VersionedSearchServer::Write(Function func) {
+  std::lock_guard guard(write_mutex_);
+
+  const int old_active = active_.load();
+  Instance &next = instances_[1 - old_active];
+  Instance &previous = instances_[old_active];
+
+  func(next.search_server);
+  ++next.version;
+  active_.store(1 - old_active);
+
+  // Копия перестала быть активной; новые читатели её не закрепят, ждём
+  // ухода уже закрепивших
+  while (previous.readers.load() != 0) {
+    std::this_thread::yield();
+  }
+
+  func(previous.search_server);
+  ++previous.version;
+}
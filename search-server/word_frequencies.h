@@ -0,0 +1,140 @@
+#pragma once
+
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Число вхождений терма в документ; частота терма - count, делённое на
+// число слов документа
+struct TermCount {
+  TermId term_id;
+  uint32_t count;
+};
+
+/**
+ * Частоты слов документа (SearchServer::GetWordFrequencies). Представление
+ * ссылается на прямой индекс документа и словарь сервера: получение ничего
+ * не копирует, а чтение безопасно из любого числа потоков.
+ *
+ * Слова перечисляются в порядке идентификаторов термов, а не в
+ * лексикографическом. Представление действительно, пока индекс не
+ * изменяется; для VersionedSearchServer - пока жив снимок, из которого оно
+ * получено.
+ */
+class WordFrequencies {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<std::string_view, double>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    Iterator(const TermDictionary *dictionary, const TermCount *position,
+      uint32_t word_count)
+      : dictionary_(dictionary)
+      , position_(position)
+      , word_count_(word_count) {
+    }
+
+    value_type operator*() const {
+      return {dictionary_->GetTerm(position_->term_id),
+        static_cast<double>(position_->count) / word_count_};
+    }
+
+    Iterator &operator++() {
+      ++position_;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator result = *this;
+      ++position_;
+      return result;
+    }
+
+    bool operator==(const Iterator &other) const {
+      return position_ == other.position_;
+    }
+
+    bool operator!=(const Iterator &other) const {
+      return position_ != other.position_;
+    }
+
+  private:
+    const TermDictionary *dictionary_;
+    const TermCount *position_;
+    uint32_t word_count_;
+  };
+
+  // Пустое представление (документа нет)
+  WordFrequencies() = default;
+
+  // [begin, end) - числа вхождений термов документа по возрастанию
+  // идентификатора, word_count - число слов документа
+  WordFrequencies(const TermDictionary &dictionary,
+    const TermCount *begin, const TermCount *end, uint32_t word_count)
+    : dictionary_(&dictionary)
+    , begin_(begin)
+    , end_(end)
+    , word_count_(word_count) {
+  }
+
+  [[nodiscard]] Iterator begin() const {
+    return {dictionary_, begin_, word_count_};
+  }
+
+  [[nodiscard]] Iterator end() const {
+    return {dictionary_, end_, word_count_};
+  }
+
+  [[nodiscard]] size_t size() const {
+    return end_ - begin_;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return begin_ == end_;
+  }
+
+  [[nodiscard]] size_t count(std::string_view word) const {
+    return Find(word) != end_ ? 1 : 0;
+  }
+
+  // Частота слова; std::out_of_range, если слова нет в документе
+  [[nodiscard]] double at(std::string_view word) const {
+    using std::string_literals::operator""s;
+
+    const TermCount *it = Find(word);
+    if (it == end_) {
+      throw std::out_of_range("Word is not in document"s);
+    }
+    return static_cast<double>(it->count) / word_count_;
+  }
+
+private:
+  const TermDictionary *dictionary_ = nullptr;
+  const TermCount *begin_ = nullptr;
+  const TermCount *end_ = nullptr;
+  uint32_t word_count_ = 0;
+
+  [[nodiscard]] const TermCount *Find(std::string_view word) const {
+    if (empty()) {
+      return end_;
+    }
+
+    const TermId term_id = dictionary_->Find(word);
+    const TermCount *it = std::lower_bound(begin_, end_, term_id,
+      [](const TermCount &term_count, TermId term_id) {
+        return term_count.term_id < term_id;
+      });
+    return it != end_ && it->term_id == term_id ? it : end_;
+  }
+};